@@ -0,0 +1,347 @@
+/* buffer_cache.c: Cache of file system disk sectors.
+ *
+ * Every sector of the file system disk that the file system reads or
+ * writes goes through a cache of BUFFER_CACHE_SIZE sectors, found by a
+ * hash on the sector number and replaced by the clock algorithm.
+ *
+ * Writes only change the cached copy and mark it dirty.  Dirty sectors
+ * reach the disk when they are evicted, when the flush daemon makes
+ * its periodic pass, and at filesys_done().  A flush writes each run
+ * of adjacent dirty sectors with one disk command.
+ *
+ * A miss on the sector right after the last one read is taken as a
+ * sequential scan: the sectors after it that are not cached are read
+ * along with it by the same command, up to a page's worth.  Reads of
+ * whole sectors fetch every missing sector of the range with one
+ * command instead, and keep them only if the range is short.
+ *
+ * One lock guards the whole cache, including across disk I/O. */
+
+#include "filesys/buffer_cache.h"
+#include <debug.h>
+#include <hash.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Sectors read or written by one command, at most: read-ahead
+ * included, or one run of a flush. */
+#define IO_SECTORS (PGSIZE / DISK_SECTOR_SIZE)
+
+/* Timer ticks between passes of the flush daemon. */
+#define FLUSH_TICKS TIMER_FREQ
+
+/* A cached sector. */
+struct cache_entry {
+	struct hash_elem elem;      /* In cache_map, if valid. */
+	disk_sector_t sector;       /* Sector held. */
+	bool valid;                 /* Holds a sector? */
+	bool dirty;                 /* Newer than the disk? */
+	bool accessed;              /* Used since the clock hand last passed? */
+	uint8_t *data;              /* DISK_SECTOR_SIZE bytes. */
+};
+
+static struct cache_entry *cache;
+static struct hash cache_map;       /* Valid entries, by sector. */
+static size_t clock_hand;           /* Next entry the clock looks at. */
+static disk_sector_t last_read;     /* Last sector read, for read-ahead. */
+static uint8_t *io_buf;             /* IO_SECTORS sectors for batched I/O. */
+static struct lock cache_lock;
+
+/* Buffer cache statistics. */
+static struct {
+	long long hits;             /* Accesses served by the cache. */
+	long long misses;           /* Accesses that were not. */
+	long long readahead;        /* Sectors read ahead of need. */
+	long long writebacks;       /* Dirty sectors written back. */
+	long long write_cmds;       /* Disk commands to write them. */
+} cache_stats;
+
+static hash_hash_func cache_hash;
+static hash_less_func cache_less;
+static void cache_flushd (void *aux);
+
+/* Sets up the cache. */
+void
+buffer_cache_init (void) {
+	size_t i;
+
+	cache = calloc (BUFFER_CACHE_SIZE, sizeof *cache);
+	io_buf = palloc_get_page (0);
+	if (cache == NULL || io_buf == NULL
+			|| !hash_init (&cache_map, cache_hash, cache_less, NULL))
+		PANIC ("buffer_cache_init: out of memory");
+	for (i = 0; i < BUFFER_CACHE_SIZE; i++) {
+		cache[i].data = malloc (DISK_SECTOR_SIZE);
+		if (cache[i].data == NULL)
+			PANIC ("buffer_cache_init: out of memory");
+	}
+	clock_hand = 0;
+	last_read = -1;
+	lock_init (&cache_lock);
+}
+
+/* Starts the flush daemon.  Its syncs reach file system metadata kept
+ * outside the cache, so it must not start before that is set up. */
+void
+buffer_cache_start_flushd (void) {
+	if (thread_create ("cache_flushd", PRI_DEFAULT, cache_flushd, NULL)
+			== TID_ERROR)
+		PANIC ("buffer_cache_start_flushd: cannot start cache_flushd");
+}
+
+static uint64_t
+cache_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct cache_entry *c = hash_entry (e, struct cache_entry, elem);
+	return hash_int (c->sector);
+}
+
+static bool
+cache_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct cache_entry, elem)->sector
+		< hash_entry (b, struct cache_entry, elem)->sector;
+}
+
+/* Returns the entry holding SECTOR, or a null pointer if it is not
+ * cached. */
+static struct cache_entry *
+cache_lookup (disk_sector_t sector) {
+	struct cache_entry key;
+	struct hash_elem *e;
+
+	key.sector = sector;
+	e = hash_find (&cache_map, &key.elem);
+	return e != NULL ? hash_entry (e, struct cache_entry, elem) : NULL;
+}
+
+/* Takes an entry for SECTOR, which must not be cached, evicting the
+ * first one the clock hand finds unused since its last pass.  A dirty
+ * victim is written back first.  The entry's data is left for the
+ * caller to fill. */
+static struct cache_entry *
+cache_alloc (disk_sector_t sector) {
+	struct cache_entry *c;
+
+	for (;;) {
+		c = &cache[clock_hand];
+		clock_hand = (clock_hand + 1) % BUFFER_CACHE_SIZE;
+		if (!c->valid)
+			break;
+		if (c->accessed) {
+			c->accessed = false;
+			continue;
+		}
+		if (c->dirty) {
+			disk_write (filesys_disk, c->sector, c->data);
+			cache_stats.writebacks++;
+			cache_stats.write_cmds++;
+		}
+		hash_delete (&cache_map, &c->elem);
+		break;
+	}
+
+	c->sector = sector;
+	c->valid = true;
+	c->dirty = false;
+	c->accessed = true;
+	hash_insert (&cache_map, &c->elem);
+	return c;
+}
+
+/* Reads SECTOR into the cache together with the sectors after it that
+ * are not cached, up to IO_SECTORS in all, by one command.  Returns
+ * SECTOR's entry.  The sectors read ahead are marked unused, so the
+ * clock takes them first if they are never needed. */
+static struct cache_entry *
+cache_readahead (disk_sector_t sector) {
+	disk_sector_t disk_end = disk_size (filesys_disk);
+	struct cache_entry *c;
+	size_t cnt = 1;
+	size_t i;
+
+	while (cnt < IO_SECTORS && sector + cnt < disk_end
+			&& cache_lookup (sector + cnt) == NULL)
+		cnt++;
+	disk_read_multiple (filesys_disk, sector, cnt, io_buf);
+
+	/* SECTOR goes in last, so that filling the others cannot evict
+	 * it. */
+	for (i = cnt - 1; i > 0; i--) {
+		c = cache_alloc (sector + i);
+		memcpy (c->data, io_buf + i * DISK_SECTOR_SIZE, DISK_SECTOR_SIZE);
+		c->accessed = false;
+	}
+	c = cache_alloc (sector);
+	memcpy (c->data, io_buf, DISK_SECTOR_SIZE);
+	cache_stats.readahead += cnt - 1;
+	return c;
+}
+
+/* Returns the entry holding SECTOR, bringing it into the cache if
+ * needed.  If READ is false, the caller is about to overwrite the
+ * whole sector, so a miss does not read it from disk. */
+static struct cache_entry *
+cache_get (disk_sector_t sector, bool read) {
+	struct cache_entry *c = cache_lookup (sector);
+
+	if (c != NULL) {
+		c->accessed = true;
+		cache_stats.hits++;
+	} else {
+		cache_stats.misses++;
+		if (!read)
+			c = cache_alloc (sector);
+		else if (sector == last_read + 1)
+			c = cache_readahead (sector);
+		else {
+			c = cache_alloc (sector);
+			disk_read (filesys_disk, sector, c->data);
+		}
+	}
+	if (read)
+		last_read = sector;
+	return c;
+}
+
+/* Reads SIZE bytes starting at byte OFS of SECTOR into BUFFER. */
+void
+buffer_cache_read (disk_sector_t sector, void *buffer, int ofs, int size) {
+	struct cache_entry *c;
+
+	ASSERT (ofs >= 0 && size >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+
+	lock_acquire (&cache_lock);
+	c = cache_get (sector, true);
+	memcpy (buffer, c->data + ofs, size);
+	lock_release (&cache_lock);
+}
+
+/* Reads the CNT whole sectors starting at SECTOR into BUFFER.  The
+ * sectors the cache holds are copied from it.  All the others are read
+ * straight into BUFFER by one command, which spans from the first
+ * missing sector to the last.  Reads of up to IO_SECTORS sectors leave
+ * what they read in the cache, marked unused.  Longer reads bypass the
+ * cache, so that one large read does not push out everything else. */
+void
+buffer_cache_read_sectors (disk_sector_t sector, size_t cnt, void *buffer) {
+	uint8_t *buf = buffer;
+	size_t first = cnt, last = 0;
+	size_t i;
+
+	ASSERT (cnt <= DISK_MAX_MULTIPLE);
+
+	lock_acquire (&cache_lock);
+	for (i = 0; i < cnt; i++)
+		if (cache_lookup (sector + i) == NULL) {
+			if (first == cnt)
+				first = i;
+			last = i;
+		}
+	if (first < cnt)
+		disk_read_multiple (filesys_disk, sector + first, last - first + 1,
+				buf + first * DISK_SECTOR_SIZE);
+
+	/* The cached copies may be newer than the disk.  They are all
+	 * copied out before anything is evicted, because evicting a dirty
+	 * sector would write it back under what was just read. */
+	for (i = 0; i < cnt; i++) {
+		struct cache_entry *c = cache_lookup (sector + i);
+
+		if (c != NULL) {
+			memcpy (buf + i * DISK_SECTOR_SIZE, c->data, DISK_SECTOR_SIZE);
+			c->accessed = true;
+			cache_stats.hits++;
+		} else
+			cache_stats.misses++;
+	}
+	if (cnt <= IO_SECTORS)
+		for (i = first; i <= last && i < cnt; i++)
+			if (cache_lookup (sector + i) == NULL) {
+				struct cache_entry *c = cache_alloc (sector + i);
+				memcpy (c->data, buf + i * DISK_SECTOR_SIZE, DISK_SECTOR_SIZE);
+				c->accessed = false;
+			}
+	if (cnt > 0)
+		last_read = sector + cnt - 1;
+	lock_release (&cache_lock);
+}
+
+/* Writes SIZE bytes from BUFFER into SECTOR starting at byte OFS.
+ * The disk is updated later. */
+void
+buffer_cache_write (disk_sector_t sector, const void *buffer, int ofs,
+		int size) {
+	struct cache_entry *c;
+
+	ASSERT (ofs >= 0 && size >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+
+	lock_acquire (&cache_lock);
+	c = cache_get (sector, ofs > 0 || size < DISK_SECTOR_SIZE);
+	memcpy (c->data + ofs, buffer, size);
+	c->dirty = true;
+	lock_release (&cache_lock);
+}
+
+/* Orders entries by sector, for qsort(). */
+static int
+entry_compare (const void *a_, const void *b_) {
+	const struct cache_entry *a = *(struct cache_entry *const *) a_;
+	const struct cache_entry *b = *(struct cache_entry *const *) b_;
+
+	return a->sector < b->sector ? -1 : a->sector > b->sector;
+}
+
+/* Writes every dirty sector back to disk, each run of adjacent ones,
+ * up to IO_SECTORS long, by one command. */
+void
+buffer_cache_flush (void) {
+	static struct cache_entry *dirty[BUFFER_CACHE_SIZE];
+	size_t cnt = 0;
+	size_t i, j;
+
+	lock_acquire (&cache_lock);
+	for (i = 0; i < BUFFER_CACHE_SIZE; i++)
+		if (cache[i].valid && cache[i].dirty)
+			dirty[cnt++] = &cache[i];
+	qsort (dirty, cnt, sizeof *dirty, entry_compare);
+
+	for (i = 0; i < cnt; i = j) {
+		for (j = i; j < cnt && j - i < IO_SECTORS
+				&& dirty[j]->sector == dirty[i]->sector + (j - i); j++) {
+			memcpy (io_buf + (j - i) * DISK_SECTOR_SIZE, dirty[j]->data,
+					DISK_SECTOR_SIZE);
+			dirty[j]->dirty = false;
+		}
+		disk_write_multiple (filesys_disk, dirty[i]->sector, j - i, io_buf);
+		cache_stats.writebacks += j - i;
+		cache_stats.write_cmds++;
+	}
+	lock_release (&cache_lock);
+}
+
+/* Flush daemon.  Syncs the whole file system, so that metadata the
+ * file system keeps outside the cache gets written too. */
+static void
+cache_flushd (void *aux UNUSED) {
+	for (;;) {
+		timer_sleep (FLUSH_TICKS);
+		filesys_sync ();
+	}
+}
+
+/* Prints buffer cache statistics. */
+void
+buffer_cache_print_stats (void) {
+	printf ("Buffer cache: %lld hits, %lld misses, %lld sectors read ahead, "
+			"%lld sectors written back in %lld writes\n",
+			cache_stats.hits, cache_stats.misses, cache_stats.readahead,
+			cache_stats.writebacks, cache_stats.write_cmds);
+}
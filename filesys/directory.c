@@ -1,7 +1,11 @@
 #include "filesys/directory.h"
+#include <round.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <list.h>
+#include <hash.h>
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
@@ -19,6 +23,54 @@ struct dir_entry {
 	bool in_use;                        /* In use or free? */
 };
 
+/* A directory starts out as a plain array of entries that is
+ * searched linearly.  Once it fills DIR_LINEAR_MAX entries it is
+ * rewritten in hashed form: slot 0 holds a header, the next
+ * DIR_INDEX_SLOTS slots hold an index, and the rest is a sequence
+ * of leaves of DIR_LEAF_ENTRIES entries each.  Every leaf holds the
+ * names whose hashes fall in one range, and the index maps the
+ * ranges, sorted by their lowest hash, to leaves.  The header and
+ * index slots keep IN_USE false in the same place as an entry, so
+ * dir_readdir() reads either form the same way.  Once the index is
+ * full, names that do not fit in their leaf go into an overflow
+ * area past the last leaf, which is searched linearly. */
+#define DIR_LINEAR_MAX 32               /* Entries before hashing. */
+#define DIR_LEAF_ENTRIES 16             /* Entries per leaf. */
+#define DIR_INDEX_SLOTS 64              /* Index slots, 2 leaves each. */
+#define DIR_LEAF_MAX (DIR_INDEX_SLOTS * 2)
+
+/* Identifies a hashed directory header. */
+#define DIR_MAGIC 0x48534944            /* "DISH" */
+
+/* Slot 0 of a hashed directory. */
+struct dir_header {
+	uint32_t magic;                     /* DIR_MAGIC. */
+	uint32_t leaf_cnt;                  /* Leaves in use. */
+	uint8_t unused[11];
+	bool in_use;                        /* Always false. */
+};
+
+/* An index slot, mapping two hash ranges to leaves. */
+struct dir_index {
+	struct {
+		uint32_t hash;                  /* Lowest hash in the leaf. */
+		uint32_t leaf;                  /* Leaf number. */
+	} range[2];
+	uint8_t unused[3];
+	bool in_use;                        /* Always false. */
+};
+
+/* A directory entry together with the hash of its name. */
+struct hashed_entry {
+	uint32_t hash;
+	struct dir_entry e;
+};
+
+/* Byte offset of the first entry of LEAF. */
+#define LEAF_OFS(LEAF) \
+	((off_t) ((1 + DIR_INDEX_SLOTS + (LEAF) * DIR_LEAF_ENTRIES) \
+	          * sizeof (struct dir_entry)))
+
 /* Creates a directory with space for ENTRY_CNT entries in the
  * given SECTOR.  Returns true if successful, false on failure. */
 bool
@@ -71,30 +123,146 @@ dir_get_inode (struct dir *dir) {
 	return dir->inode;
 }
 
+/* Returns the hash of NAME used to place it in a hashed
+ * directory. */
+static uint32_t
+name_hash (const char *name) {
+	return hash_string (name);
+}
+
+/* Reads the header of DIR into *H.  Returns true if DIR is in
+ * hashed form, false if it is a plain array of entries. */
+static bool
+read_header (const struct dir *dir, struct dir_header *h) {
+	return inode_read_at (dir->inode, h, sizeof *h, 0) == sizeof *h
+		&& !h->in_use && h->magic == DIR_MAGIC
+		&& h->leaf_cnt > 0 && h->leaf_cnt <= DIR_LEAF_MAX;
+}
+
+/* Reads the index of a hashed directory DIR with LEAF_CNT leaves.
+ * Returns a buffer the caller must free, or a null pointer if
+ * memory is short or the read fails. */
+static struct dir_index *
+read_index (const struct dir *dir, size_t leaf_cnt) {
+	size_t size = DIV_ROUND_UP (leaf_cnt, 2) * sizeof (struct dir_index);
+	struct dir_index *idx = calloc (DIR_INDEX_SLOTS, sizeof *idx);
+
+	if (idx != NULL && inode_read_at (dir->inode, idx, size,
+				sizeof (struct dir_header)) != (off_t) size) {
+		free (idx);
+		idx = NULL;
+	}
+	return idx;
+}
+
+/* Writes the first LEAF_CNT ranges of IDX to DIR, along with a
+ * header that gives LEAF_CNT. */
+static bool
+write_index (struct dir *dir, const struct dir_index *idx, size_t leaf_cnt) {
+	size_t size = DIV_ROUND_UP (leaf_cnt, 2) * sizeof (struct dir_index);
+	struct dir_header h;
+
+	memset (&h, 0, sizeof h);
+	h.magic = DIR_MAGIC;
+	h.leaf_cnt = leaf_cnt;
+	return inode_write_at (dir->inode, idx, size, sizeof h) == (off_t) size
+		&& inode_write_at (dir->inode, &h, sizeof h, 0) == sizeof h;
+}
+
+/* Returns the position in IDX, which has LEAF_CNT ranges, of the
+ * range that HASH falls in. */
+static size_t
+find_range (const struct dir_index *idx, size_t leaf_cnt, uint32_t hash) {
+	size_t lo = 0, hi = leaf_cnt;
+
+	/* The first range always starts at 0, so the answer is the
+	 * last range whose lowest hash is at most HASH. */
+	while (hi - lo > 1) {
+		size_t mid = (lo + hi) / 2;
+		if (idx[mid / 2].range[mid % 2].hash <= hash)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* Stores HASH and LEAF as range I of IDX. */
+static void
+set_range (struct dir_index *idx, size_t i, uint32_t hash, uint32_t leaf) {
+	idx[i / 2].range[i % 2].hash = hash;
+	idx[i / 2].range[i % 2].leaf = leaf;
+}
+
+/* Searches the entries of DIR in [OFS, END) for one named NAME, or
+ * for a free one if NAME is a null pointer.  On success, returns
+ * true and sets *EP and *OFSP as lookup() does.  Entries are read
+ * DIR_LEAF_ENTRIES at a time. */
+static bool
+scan (const struct dir *dir, const char *name, off_t ofs, off_t end,
+		struct dir_entry *ep, off_t *ofsp) {
+	struct dir_entry buf[DIR_LEAF_ENTRIES];
+
+	while (ofs < end) {
+		off_t size = end - ofs < (off_t) sizeof buf ? end - ofs : (off_t) sizeof buf;
+		size_t cnt = inode_read_at (dir->inode, buf, size, ofs) / sizeof *buf;
+		size_t i;
+
+		if (cnt == 0)
+			break;
+		for (i = 0; i < cnt; i++, ofs += sizeof *buf)
+			if (name != NULL ? buf[i].in_use && !strcmp (name, buf[i].name)
+					: !buf[i].in_use) {
+				if (ep != NULL)
+					*ep = buf[i];
+				if (ofsp != NULL)
+					*ofsp = ofs;
+				return true;
+			}
+	}
+	return false;
+}
+
+/* Result of lookup(). */
+enum lookup_result {
+	LOOKUP_FOUND,                       /* NAME is in the directory. */
+	LOOKUP_MISSING,                     /* NAME is not. */
+	LOOKUP_ERROR                        /* Could not tell: out of memory. */
+};
+
 /* Searches DIR for a file with the given NAME.
- * If successful, returns true, sets *EP to the directory entry
- * if EP is non-null, and sets *OFSP to the byte offset of the
+ * If successful, returns LOOKUP_FOUND, sets *EP to the directory
+ * entry if EP is non-null, and sets *OFSP to the byte offset of the
  * directory entry if OFSP is non-null.
- * otherwise, returns false and ignores EP and OFSP. */
-static bool
+ * Otherwise, returns LOOKUP_MISSING, or LOOKUP_ERROR if the index of
+ * a hashed directory could not be read, and ignores EP and OFSP. */
+static enum lookup_result
 lookup (const struct dir *dir, const char *name,
 		struct dir_entry *ep, off_t *ofsp) {
-	struct dir_entry e;
-	size_t ofs;
+	struct dir_header h;
+	bool found;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
-	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-			ofs += sizeof e)
-		if (e.in_use && !strcmp (name, e.name)) {
-			if (ep != NULL)
-				*ep = e;
-			if (ofsp != NULL)
-				*ofsp = ofs;
-			return true;
-		}
-	return false;
+	if (read_header (dir, &h)) {
+		struct dir_index *idx = read_index (dir, h.leaf_cnt);
+		size_t i;
+		off_t ofs;
+
+		if (idx == NULL)
+			return LOOKUP_ERROR;
+		i = find_range (idx, h.leaf_cnt, name_hash (name));
+		ofs = LEAF_OFS (idx[i / 2].range[i % 2].leaf);
+		free (idx);
+		found = scan (dir, name, ofs,
+				ofs + DIR_LEAF_ENTRIES * sizeof (struct dir_entry), ep, ofsp)
+			|| (h.leaf_cnt == DIR_LEAF_MAX
+				&& scan (dir, name, LEAF_OFS (DIR_LEAF_MAX),
+					inode_length (dir->inode), ep, ofsp));
+	} else
+		found = scan (dir, name, 0, inode_length (dir->inode), ep, ofsp);
+	return found ? LOOKUP_FOUND : LOOKUP_MISSING;
 }
 
 /* Searches DIR for a file with the given NAME
@@ -109,7 +277,7 @@ dir_lookup (const struct dir *dir, const char *name,
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
-	if (lookup (dir, name, &e, NULL))
+	if (lookup (dir, name, &e, NULL) == LOOKUP_FOUND)
 		*inode = inode_open (e.inode_sector);
 	else
 		*inode = NULL;
@@ -117,6 +285,201 @@ dir_lookup (const struct dir *dir, const char *name,
 	return *inode != NULL;
 }
 
+/* Orders hashed_entry structures by hash. */
+static int
+compare_hash (const void *a_, const void *b_) {
+	const struct hashed_entry *a = a_;
+	const struct hashed_entry *b = b_;
+
+	return a->hash < b->hash ? -1 : a->hash > b->hash;
+}
+
+/* Reads the CNT entries of DIR starting at OFS into a new array of
+ * hashed_entry structures, leaves out the free ones, and sorts the
+ * rest by hash.  Stores the number kept in *KEPT and returns the
+ * array, which the caller must free, or a null pointer on failure. */
+static struct hashed_entry *
+read_sorted (const struct dir *dir, off_t ofs, size_t cnt, size_t *kept) {
+	off_t size = cnt * sizeof (struct dir_entry);
+	struct hashed_entry *v = malloc (cnt * sizeof *v);
+	struct dir_entry *buf = malloc (size);
+	size_t i;
+
+	if (v == NULL || buf == NULL
+			|| inode_read_at (dir->inode, buf, size, ofs) != size) {
+		free (buf);
+		free (v);
+		return NULL;
+	}
+	*kept = 0;
+	for (i = 0; i < cnt; i++)
+		if (buf[i].in_use) {
+			v[*kept].hash = name_hash (buf[i].name);
+			v[(*kept)++].e = buf[i];
+		}
+	free (buf);
+	qsort (v, *kept, sizeof *v, compare_hash);
+	return v;
+}
+
+/* Writes the CNT entries of V into LEAF of DIR, padding the leaf
+ * with free entries. */
+static bool
+write_leaf (struct dir *dir, uint32_t leaf, const struct hashed_entry *v,
+		size_t cnt) {
+	struct dir_entry buf[DIR_LEAF_ENTRIES];
+	size_t i;
+
+	ASSERT (cnt <= DIR_LEAF_ENTRIES);
+	memset (buf, 0, sizeof buf);
+	for (i = 0; i < cnt; i++)
+		buf[i] = v[i].e;
+	return inode_write_at (dir->inode, buf, sizeof buf, LEAF_OFS (leaf))
+		== sizeof buf;
+}
+
+/* Returns the number of leading entries of the CNT in V, sorted by
+ * hash, that go into one leaf filled to about FILL entries.  Names
+ * with the same hash are never split between leaves.  Returns 0 if
+ * they do not fit in one. */
+static size_t
+leaf_cut (const struct hashed_entry *v, size_t cnt, size_t fill) {
+	size_t cut;
+
+	if (cnt <= fill)
+		return cnt;
+	for (cut = fill; cut > 0 && v[cut - 1].hash == v[cut].hash; cut--)
+		continue;
+	if (cut == 0)
+		for (cut = fill; cut < cnt && v[cut - 1].hash == v[cut].hash; cut++)
+			continue;
+	return cut <= DIR_LEAF_ENTRIES ? cut : 0;
+}
+
+/* Rewrites DIR, a plain array of entries, in hashed form, with its
+ * leaves about three quarters full.  Returns false, leaving DIR as
+ * it was, if memory or disk space is short, the array is too big to
+ * convert, or the entries will not fit. */
+static bool
+make_hashed (struct dir *dir) {
+	size_t old_cnt = inode_length (dir->inode) / sizeof (struct dir_entry);
+	struct dir_index *idx = NULL;
+	struct hashed_entry *v = NULL;
+	size_t cnt, leaf_cnt, i, cut;
+	bool success = false;
+
+	/* An array created larger than the index area stays plain. */
+	if (old_cnt > 1 + DIR_INDEX_SLOTS)
+		return false;
+	v = read_sorted (dir, 0, old_cnt, &cnt);
+	idx = calloc (DIR_INDEX_SLOTS, sizeof *idx);
+	if (v == NULL || idx == NULL)
+		goto done;
+
+	/* Plan the leaves before writing anything. */
+	for (i = leaf_cnt = 0; i < cnt || leaf_cnt == 0; i += cut, leaf_cnt++) {
+		cut = leaf_cut (v + i, cnt - i, DIR_LEAF_ENTRIES * 3 / 4);
+		if ((cut == 0 && i < cnt) || leaf_cnt == DIR_LEAF_MAX)
+			goto done;
+		set_range (idx, leaf_cnt, leaf_cnt == 0 ? 0 : v[i].hash, leaf_cnt);
+	}
+
+	/* The leaves lie past the old array, so writing them, the only
+	 * step that grows the file, leaves the old entries intact if it
+	 * fails.  Then the whole index area is written, freeing the old
+	 * entries under it, and last the header, which makes the new
+	 * form visible.  Neither of those allocates. */
+	for (i = leaf_cnt = 0; i < cnt || leaf_cnt == 0; i += cut, leaf_cnt++) {
+		cut = leaf_cut (v + i, cnt - i, DIR_LEAF_ENTRIES * 3 / 4);
+		if (!write_leaf (dir, leaf_cnt, v + i, cut))
+			goto done;
+	}
+	if (inode_write_at (dir->inode, idx, DIR_INDEX_SLOTS * sizeof *idx,
+				sizeof (struct dir_header))
+			!= (off_t) (DIR_INDEX_SLOTS * sizeof *idx))
+		goto done;
+	success = write_index (dir, idx, leaf_cnt);
+
+done:
+	free (idx);
+	free (v);
+	return success;
+}
+
+/* Splits the full leaf of hashed directory DIR at range I of IDX,
+ * which has LEAF_CNT ranges, moving the upper half of its hashes to
+ * a new leaf.  Returns false if the index is full, the leaf holds
+ * a single hash, or a disk or memory error occurs. */
+static bool
+split_leaf (struct dir *dir, struct dir_index *idx, size_t leaf_cnt,
+		size_t i) {
+	uint32_t leaf = idx[i / 2].range[i % 2].leaf;
+	struct hashed_entry *v;
+	size_t cnt, cut, j;
+	bool success = false;
+
+	if (leaf_cnt == DIR_LEAF_MAX)
+		return false;
+	v = read_sorted (dir, LEAF_OFS (leaf), DIR_LEAF_ENTRIES, &cnt);
+	if (v == NULL)
+		return false;
+	cut = leaf_cut (v, cnt, cnt / 2);
+	if (cut == 0 || cut == cnt)
+		goto done;
+
+	/* Fill in the new leaf before pointing the index at it. */
+	if (!write_leaf (dir, leaf_cnt, v + cut, cnt - cut)
+			|| !write_leaf (dir, leaf, v, cut))
+		goto done;
+	for (j = leaf_cnt; j > i + 1; j--)
+		set_range (idx, j, idx[(j - 1) / 2].range[(j - 1) % 2].hash,
+				idx[(j - 1) / 2].range[(j - 1) % 2].leaf);
+	set_range (idx, i + 1, v[cut].hash, leaf_cnt);
+	success = write_index (dir, idx, leaf_cnt + 1);
+
+done:
+	free (v);
+	return success;
+}
+
+/* Finds a free slot for NAME in hashed directory DIR, whose header
+ * is H, splitting leaves as needed, or in the overflow area once
+ * the index is full.  Stores its offset in *OFSP. */
+static bool
+hashed_slot (struct dir *dir, struct dir_header *h, const char *name,
+		off_t *ofsp) {
+	uint32_t hash = name_hash (name);
+	struct dir_index *idx;
+	bool success = false;
+
+	idx = read_index (dir, h->leaf_cnt);
+	if (idx == NULL)
+		return false;
+	for (;;) {
+		size_t i = find_range (idx, h->leaf_cnt, hash);
+		off_t ofs = LEAF_OFS (idx[i / 2].range[i % 2].leaf);
+
+		if (scan (dir, NULL, ofs,
+					ofs + DIR_LEAF_ENTRIES * sizeof (struct dir_entry), NULL, ofsp)) {
+			success = true;
+			break;
+		}
+		if (split_leaf (dir, idx, h->leaf_cnt, i))
+			h->leaf_cnt++;
+		else {
+			if (h->leaf_cnt == DIR_LEAF_MAX) {
+				off_t end = inode_length (dir->inode);
+				if (!scan (dir, NULL, LEAF_OFS (DIR_LEAF_MAX), end, NULL, ofsp))
+					*ofsp = end;
+				success = true;
+			}
+			break;
+		}
+	}
+	free (idx);
+	return success;
+}
+
 /* Adds a file named NAME to DIR, which must not already contain a
  * file by that name.  The file's inode is in sector
  * INODE_SECTOR.
@@ -125,8 +488,10 @@ dir_lookup (const struct dir *dir, const char *name,
  * error occurs. */
 bool
 dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
+	struct dir_header h;
 	struct dir_entry e;
 	off_t ofs;
+	bool hashed;
 	bool success = false;
 
 	ASSERT (dir != NULL);
@@ -136,21 +501,31 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
 	if (*name == '\0' || strlen (name) > NAME_MAX)
 		return false;
 
-	/* Check that NAME is not in use. */
-	if (lookup (dir, name, NULL, NULL))
+	/* Check that NAME is not in use.  If that cannot be told, adding
+	 * it might make a second entry by the same name. */
+	if (lookup (dir, name, NULL, NULL) != LOOKUP_MISSING)
 		goto done;
 
 	/* Set OFS to offset of free slot.
-	 * If there are no free slots, then it will be set to the
-	 * current end-of-file.
+	 * A plain directory that has filled DIR_LINEAR_MAX entries is
+	 * hashed first.  Otherwise, if there are no free slots, OFS is
+	 * set to the current end-of-file.
 
 	 * inode_read_at() will only return a short read at end of file.
 	 * Otherwise, we'd need to verify that we didn't get a short
 	 * read due to something intermittent such as low memory. */
-	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-			ofs += sizeof e)
-		if (!e.in_use)
-			break;
+	hashed = read_header (dir, &h);
+	if (!hashed) {
+		off_t end = inode_length (dir->inode);
+
+		if (!scan (dir, NULL, 0, end, NULL, &ofs)) {
+			ofs = end;
+			if (end / sizeof e >= DIR_LINEAR_MAX && make_hashed (dir))
+				hashed = read_header (dir, &h);
+		}
+	}
+	if (hashed && !hashed_slot (dir, &h, name, &ofs))
+		goto done;
 
 	/* Write slot. */
 	e.in_use = true;
@@ -164,7 +539,9 @@ done:
 
 /* Removes any entry for NAME in DIR.
  * Returns true if successful, false on failure,
- * which occurs only if there is no file with the given NAME. */
+ * which occurs only if there is no file with the given NAME.
+ * In a hashed directory the entry's leaf keeps its hash range;
+ * leaves are never merged. */
 bool
 dir_remove (struct dir *dir, const char *name) {
 	struct dir_entry e;
@@ -176,7 +553,7 @@ dir_remove (struct dir *dir, const char *name) {
 	ASSERT (name != NULL);
 
 	/* Find directory entry. */
-	if (!lookup (dir, name, &e, &ofs))
+	if (lookup (dir, name, &e, &ofs) != LOOKUP_FOUND)
 		goto done;
 
 	/* Open inode. */
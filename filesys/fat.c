@@ -1,5 +1,7 @@
 #include "filesys/fat.h"
+#include <bitmap.h>
 #include "devices/disk.h"
+#include "filesys/buffer_cache.h"
 #include "filesys/filesys.h"
 #include "threads/malloc.h"
 #include "threads/synch.h"
@@ -23,6 +25,8 @@ struct fat_fs {
 	unsigned int fat_length;
 	disk_sector_t data_start;
 	cluster_t last_clst;
+	struct bitmap *used_clsts;  /* Set bit: cluster is in use. */
+	struct bitmap *dirty_sectors; /* Set bit: FAT sector changed in memory. */
 	struct lock write_lock;
 };
 
@@ -30,6 +34,7 @@ static struct fat_fs *fat_fs;
 
 void fat_boot_create (void);
 void fat_fs_init (void);
+static void fat_index_build (void);
 
 void
 fat_init (void) {
@@ -53,7 +58,10 @@ fat_init (void) {
 
 void
 fat_open (void) {
-	fat_fs->fat = calloc (fat_fs->fat_length, sizeof (cluster_t));
+	/* The table is kept in whole sectors, so that changed sectors can
+	 * be written straight from it. */
+	free (fat_fs->fat);
+	fat_fs->fat = calloc (fat_fs->bs.fat_sectors, DISK_SECTOR_SIZE);
 	if (fat_fs->fat == NULL)
 		PANIC ("FAT load failed");
 
@@ -78,6 +86,8 @@ fat_open (void) {
 			free (bounce);
 		}
 	}
+
+	fat_index_build ();
 }
 
 void
@@ -90,27 +100,8 @@ fat_close (void) {
 	disk_write (filesys_disk, FAT_BOOT_SECTOR, bounce);
 	free (bounce);
 
-	// Write FAT directly to the disk
-	uint8_t *buffer = (uint8_t *) fat_fs->fat;
-	off_t bytes_wrote = 0;
-	off_t bytes_left = sizeof (fat_fs->fat);
-	const off_t fat_size_in_bytes = fat_fs->fat_length * sizeof (cluster_t);
-	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++) {
-		bytes_left = fat_size_in_bytes - bytes_wrote;
-		if (bytes_left >= DISK_SECTOR_SIZE) {
-			disk_write (filesys_disk, fat_fs->bs.fat_start + i,
-			            buffer + bytes_wrote);
-			bytes_wrote += DISK_SECTOR_SIZE;
-		} else {
-			bounce = calloc (1, DISK_SECTOR_SIZE);
-			if (bounce == NULL)
-				PANIC ("FAT close failed");
-			memcpy (bounce, buffer + bytes_wrote, bytes_left);
-			disk_write (filesys_disk, fat_fs->bs.fat_start + i, bounce);
-			bytes_wrote += bytes_left;
-			free (bounce);
-		}
-	}
+	// Write the changed part of the FAT
+	fat_sync ();
 }
 
 void
@@ -119,10 +110,12 @@ fat_create (void) {
 	fat_boot_create ();
 	fat_fs_init ();
 
-	// Create FAT table
-	fat_fs->fat = calloc (fat_fs->fat_length, sizeof (cluster_t));
+	// Create FAT table, all of which has to be written out
+	fat_fs->fat = calloc (fat_fs->bs.fat_sectors, DISK_SECTOR_SIZE);
 	if (fat_fs->fat == NULL)
 		PANIC ("FAT creation failed");
+	fat_index_build ();
+	bitmap_set_all (fat_fs->dirty_sectors, true);
 
 	// Set up ROOT_DIR_CLST
 	fat_put (ROOT_DIR_CLUSTER, EOChain);
@@ -131,7 +124,8 @@ fat_create (void) {
 	uint8_t *buf = calloc (1, DISK_SECTOR_SIZE);
 	if (buf == NULL)
 		PANIC ("FAT create failed due to OOM");
-	disk_write (filesys_disk, cluster_to_sector (ROOT_DIR_CLUSTER), buf);
+	buffer_cache_write (cluster_to_sector (ROOT_DIR_CLUSTER), buf, 0,
+			DISK_SECTOR_SIZE);
 	free (buf);
 }
 
@@ -152,42 +146,148 @@ fat_boot_create (void) {
 
 void
 fat_fs_init (void) {
-	/* TODO: Your code goes here. */
+	/* Clusters are numbered from 1, at the first sector after the
+	 * FAT; entry 0 of the FAT is unused. */
+	fat_fs->data_start = fat_fs->bs.fat_start + fat_fs->bs.fat_sectors;
+	fat_fs->fat_length = (fat_fs->bs.total_sectors - fat_fs->data_start)
+		/ SECTORS_PER_CLUSTER + 1;
+	fat_fs->last_clst = ROOT_DIR_CLUSTER;
+	lock_init (&fat_fs->write_lock);
+
+	bitmap_destroy (fat_fs->dirty_sectors);
+	fat_fs->dirty_sectors = bitmap_create (fat_fs->bs.fat_sectors);
+	if (fat_fs->dirty_sectors == NULL)
+		PANIC ("FAT init failed");
+}
+
+/* Writes the FAT sectors changed since the last sync to disk, each
+ * run of adjacent ones by one command. */
+void
+fat_sync (void) {
+	struct bitmap *dirty;
+	size_t i = 0;
+
+	/* The flush daemon may get here before fat_init(). */
+	if (fat_fs == NULL || fat_fs->fat == NULL
+			|| fat_fs->dirty_sectors == NULL)
+		return;
+	dirty = fat_fs->dirty_sectors;
+	lock_acquire (&fat_fs->write_lock);
+	while ((i = bitmap_scan (dirty, i, 1, true)) != BITMAP_ERROR) {
+		size_t j = bitmap_scan (dirty, i, 1, false);
+
+		if (j == BITMAP_ERROR)
+			j = bitmap_size (dirty);
+		if (j - i > DISK_MAX_MULTIPLE)
+			j = i + DISK_MAX_MULTIPLE;
+		disk_write_multiple (filesys_disk, fat_fs->bs.fat_start + i, j - i,
+				(uint8_t *) fat_fs->fat + i * DISK_SECTOR_SIZE);
+		bitmap_set_multiple (dirty, i, j - i, false);
+		i = j;
+	}
+	lock_release (&fat_fs->write_lock);
 }
 
 /*----------------------------------------------------------------------------*/
 /* FAT handling                                                               */
 /*----------------------------------------------------------------------------*/
 
+/* Builds the index of clusters in use from the FAT, so that allocation
+ * searches a bit per cluster, a word at a time, instead of the table.
+ * Cluster 0 does not exist and counts as used. */
+static void
+fat_index_build (void) {
+	cluster_t clst;
+
+	bitmap_destroy (fat_fs->used_clsts);
+	fat_fs->used_clsts = bitmap_create (fat_fs->fat_length);
+	if (fat_fs->used_clsts == NULL)
+		PANIC ("FAT index creation failed");
+	bitmap_mark (fat_fs->used_clsts, 0);
+	for (clst = 1; clst < fat_fs->fat_length; clst++)
+		if (fat_fs->fat[clst] != 0)
+			bitmap_mark (fat_fs->used_clsts, clst);
+}
+
 /* Add a cluster to the chain.
  * If CLST is 0, start a new chain.
  * Returns 0 if fails to allocate a new cluster. */
 cluster_t
 fat_create_chain (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	struct bitmap *used = fat_fs->used_clsts;
+	size_t new;
+
+	ASSERT (clst < fat_fs->fat_length);
+
+	lock_acquire (&fat_fs->write_lock);
+	/* Take the cluster right after CLST if it is free, so that a file
+	 * written in order lies in one run.  Otherwise take the next free
+	 * cluster after the last one allocated, wrapping around. */
+	if (clst != 0 && clst + 1 < fat_fs->fat_length
+			&& !bitmap_test (used, clst + 1))
+		new = clst + 1;
+	else {
+		new = bitmap_scan (used, fat_fs->last_clst, 1, false);
+		if (new == BITMAP_ERROR)
+			new = bitmap_scan (used, 0, 1, false);
+	}
+	if (new == BITMAP_ERROR) {
+		lock_release (&fat_fs->write_lock);
+		return 0;
+	}
+
+	fat_put (new, EOChain);
+	if (clst != 0)
+		fat_put (clst, new);
+	fat_fs->last_clst = new;
+	lock_release (&fat_fs->write_lock);
+	return new;
 }
 
 /* Remove the chain of clusters starting from CLST.
  * If PCLST is 0, assume CLST as the start of the chain. */
 void
 fat_remove_chain (cluster_t clst, cluster_t pclst) {
-	/* TODO: Your code goes here. */
+	lock_acquire (&fat_fs->write_lock);
+	if (pclst != 0)
+		fat_put (pclst, EOChain);
+	while (clst != 0 && clst != EOChain) {
+		cluster_t next = fat_get (clst);
+		fat_put (clst, 0);
+		clst = next;
+	}
+	lock_release (&fat_fs->write_lock);
 }
 
-/* Update a value in the FAT table. */
+/* Update a value in the FAT table, keeping the index of clusters in
+ * use up to date and marking the sector holding the entry for the
+ * next sync. */
 void
 fat_put (cluster_t clst, cluster_t val) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst > 0 && clst < fat_fs->fat_length);
+	fat_fs->fat[clst] = val;
+	bitmap_set (fat_fs->used_clsts, clst, val != 0);
+	bitmap_mark (fat_fs->dirty_sectors,
+			clst / (DISK_SECTOR_SIZE / sizeof (cluster_t)));
 }
 
 /* Fetch a value in the FAT table. */
 cluster_t
 fat_get (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst > 0 && clst < fat_fs->fat_length);
+	return fat_fs->fat[clst];
 }
 
 /* Covert a cluster # to a sector number. */
 disk_sector_t
 cluster_to_sector (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst > 0 && clst < fat_fs->fat_length);
+	return fat_fs->data_start + (clst - 1) * SECTORS_PER_CLUSTER;
+}
+
+/* Covert a sector # to the cluster # that holds it. */
+cluster_t
+sector_to_cluster (disk_sector_t sector) {
+	ASSERT (sector >= fat_fs->data_start);
+	return (sector - fat_fs->data_start) / SECTORS_PER_CLUSTER + 1;
 }
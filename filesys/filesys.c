@@ -2,6 +2,7 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/buffer_cache.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
@@ -21,6 +22,7 @@ filesys_init (bool format) {
 	if (filesys_disk == NULL)
 		PANIC ("hd0:1 (hdb) not present, file system initialization failed");
 
+	buffer_cache_init ();
 	inode_init ();
 
 #ifdef EFILESYS
@@ -39,6 +41,9 @@ filesys_init (bool format) {
 
 	free_map_open ();
 #endif
+
+	/* 플러시 데몬은 FAT과 free map이 준비된 뒤에 띄운다. */
+	buffer_cache_start_flushd ();
 }
 
 /*	파일 시스템 모듈을 닫고 아직 디스크에 기록되지 않은 모든 데이터를 디스크에 쓴다. */
@@ -50,6 +55,17 @@ filesys_done (void) {
 #else
 	free_map_close ();
 #endif
+	buffer_cache_flush ();
+}
+
+/*	아직 디스크에 기록되지 않은 파일 시스템 메타데이터와 데이터를 디스크에 쓴다.
+	FAT에서는 바뀐 FAT 섹터만 쓴다. */
+void
+filesys_sync (void) {
+#ifdef EFILESYS
+	fat_sync ();
+#endif
+	buffer_cache_flush ();
 }
 
 /*	name으로 이름이 지어지고 initial_size로 초기화된 파일을 만든다.
@@ -61,11 +77,11 @@ filesys_create (const char *name, off_t initial_size) {
 	disk_sector_t inode_sector = 0;
 	struct dir *dir = dir_open_root ();
 	bool success = (dir != NULL
-			&& free_map_allocate (1, &inode_sector)
+			&& inode_allocate_sector (&inode_sector)
 			&& inode_create (inode_sector, initial_size)
 			&& dir_add (dir, name, inode_sector));
 	if (!success && inode_sector != 0)
-		free_map_release (inode_sector, 1);
+		inode_release_sector (inode_sector);
 	dir_close (dir);
 
 	return success;
@@ -109,6 +125,8 @@ do_format (void) {
 #ifdef EFILESYS
 	/* Create FAT and save it to the disk. */
 	fat_create ();
+	if (!dir_create (ROOT_DIR_SECTOR, 16))
+		PANIC ("root directory creation failed");
 	fat_close ();
 #else
 	free_map_create ();
@@ -36,6 +36,39 @@ free_map_allocate (size_t cnt, disk_sector_t *sectorp) {
 	return sector != BITMAP_ERROR;
 }
 
+/* Allocates up to CNT consecutive sectors from the free map, stores
+ * the first into *SECTORP and returns how many there are, or 0 if
+ * the disk is full.  The run starts at HINT if that sector is free,
+ * so that a file can grow in place; otherwise it is the first free
+ * run of CNT sectors or, if there is none, the first free sectors. */
+size_t
+free_map_allocate_run (disk_sector_t hint, size_t cnt,
+		disk_sector_t *sectorp) {
+	size_t size = bitmap_size (free_map);
+	size_t start, got = 0;
+
+	if (hint < size && !bitmap_test (free_map, hint))
+		start = hint;
+	else {
+		start = bitmap_scan (free_map, 0, cnt, false);
+		if (start == BITMAP_ERROR)
+			start = bitmap_scan (free_map, 0, 1, false);
+		if (start == BITMAP_ERROR)
+			return 0;
+	}
+	while (got < cnt && start + got < size
+			&& !bitmap_test (free_map, start + got))
+		got++;
+
+	bitmap_set_multiple (free_map, start, got, true);
+	if (free_map_file != NULL && !bitmap_write (free_map, free_map_file)) {
+		bitmap_set_multiple (free_map, start, got, false);
+		return 0;
+	}
+	*sectorp = start;
+	return got;
+}
+
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (disk_sector_t sector, size_t cnt) {
@@ -2,27 +2,80 @@
 #include <list.h>
 #include <debug.h>
 #include <round.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <string.h>
+#include "filesys/buffer_cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#ifdef EFILESYS
+#include "filesys/fat.h"
+#endif
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Sectors a file is grown by at least, when written past its end, so
+ * that files growing side by side do not interleave sector by sector. */
+#define GROW_SECTORS 8
+
+#ifndef EFILESYS
+/* A run of sectors holding consecutive sectors of a file. */
+struct extent {
+	uint32_t ofs;                       /* First file sector it holds. */
+	disk_sector_t start;                /* First disk sector. */
+	uint32_t length;                    /* Number of sectors. */
+};
+
+/* Extents kept in the inode itself, and in each index block. */
+#define INLINE_EXTENTS 41
+#define INDEX_EXTENTS 42
+
 /* On-disk inode.
  * Must be exactly DISK_SECTOR_SIZE bytes long. */
 /* 	
 	실제 디스크 상에 올라가있는 인덱스 노드
 	실제 파일에 대한 메타 데이터를 가지고 있음.
-	디스크상에 길이가 어느정도로 올라가있는지, 
-	512byte를 맞춰주기 위해 사용하지않는 나머지 공간이 어느정도인지 기록되어있음 */
+	데이터는 익스텐트(연속된 섹터 구간)들의 목록으로 기록되며,
+	앞의 INLINE_EXTENTS개는 inode 안에, 나머지는 인덱스 블록 체인에 들어있음. */
+struct inode_disk {
+	off_t length;                       /* 파일 길이 (바이트). */
+	unsigned magic;                     /* Magic number. */
+	uint32_t extent_cnt;                /* 익스텐트 수 (인덱스 블록 포함). */
+	disk_sector_t index;                /* 첫 인덱스 블록, 없으면 0. */
+	struct extent extents[INLINE_EXTENTS]; /* 앞쪽 익스텐트들. */
+	uint32_t unused[1];                 /* 512byte를 맞춰주기 위한 쓰지않는 공간. */
+};
+
+/* Index block: the extents that do not fit in the inode, in file
+ * order, INDEX_EXTENTS per block. */
+struct index_disk {
+	disk_sector_t next;                 /* Next index block, or 0. */
+	uint32_t unused;
+	struct extent extents[INDEX_EXTENTS];
+};
+#else /* EFILESYS */
+/* A run of clusters that follow each other both in a file's chain
+ * and on disk. */
+struct cluster_run {
+	uint32_t ofs;                       /* First file cluster it holds. */
+	cluster_t start;                    /* First disk cluster. */
+	uint32_t length;                    /* Number of clusters. */
+};
+
+/* On-disk inode.
+ * Must be exactly DISK_SECTOR_SIZE bytes long. */
+/*
+	FAT 위의 인덱스 노드. 데이터는 start에서 시작하는 클러스터 체인에
+	들어있음. 한 클러스터는 한 섹터. */
 struct inode_disk {
-	disk_sector_t start;                /* 첫 시작 데이터 섹터 */
-	off_t length;                       /* 저장된 공간의 길이 (start + length)만큼 저장되어있음 */
+	cluster_t start;                    /* 첫 데이터 클러스터, 없으면 0. */
+	off_t length;                       /* 파일 길이 (바이트). */
 	unsigned magic;                     /* Magic number. */
 	uint32_t unused[125];               /* 512byte를 맞춰주기 위한 쓰지않는 공간. */
 };
+#endif /* EFILESYS */
 
 /* Returns the number of sectors to allocate for an inode SIZE
  * bytes long. */
@@ -35,7 +88,8 @@ bytes_to_sectors (off_t size) {
 /*
 	메모리 공간 상에 들어있는 노드
 	디스크 상 위치, 열린 횟수, 삭제됬는지 아닌지, write해도 되는지
-	디스크상의 메타 데이터 정보도 들어있음. */
+	디스크상의 메타 데이터 정보도 들어있음.
+	인덱스 블록에 있는 익스텐트들은 열 때 모두 읽어 spill에 둠. */
 struct inode {
 	struct list_elem elem;              /* inode list를 위한 element. */
 	disk_sector_t sector;               /* 디스크 상의 섹터 위치. */
@@ -43,19 +97,427 @@ struct inode {
 	bool removed;                       /* 삭제됬다면 True 아니면 False. */
 	int deny_write_cnt;                 /* 0이면 써도됨, 아니면 안됨. */
 	struct inode_disk data;             /* 디스크에 저장된 메타데이터 정보보. */
+#ifndef EFILESYS
+	struct extent *spill;               /* 인덱스 블록의 익스텐트들. */
+	disk_sector_t *blocks;              /* 인덱스 블록들의 섹터. */
+	size_t block_cnt;                   /* 인덱스 블록 수. */
+#else
+	struct cluster_run *runs;           /* 지금까지 따라간 체인의 구간들. */
+	size_t run_cnt;                     /* runs의 항목 수. */
+	size_t run_cap;                     /* runs에 할당된 항목 수. */
+	bool chain_end;                     /* 체인 끝까지 따라갔는지. */
+#endif
 };
 
+#ifndef EFILESYS
+
+/* Returns extent I of INODE. */
+static struct extent *
+extent_at (struct inode *inode, size_t i) {
+	ASSERT (i < inode->data.extent_cnt);
+	return i < INLINE_EXTENTS ? &inode->data.extents[i]
+		: &inode->spill[i - INLINE_EXTENTS];
+}
+
+/* Returns the number of sectors allocated to INODE, which may be more
+ * than its length needs. */
+static size_t
+allocated_sectors (struct inode *inode) {
+	struct extent *last;
+
+	if (inode->data.extent_cnt == 0)
+		return 0;
+	last = extent_at (inode, inode->data.extent_cnt - 1);
+	return last->ofs + last->length;
+}
+
+/* Returns the disk sector that contains byte offset POS within
+ * INODE, found by binary search over its extents.
+ * Returns -1 if INODE does not contain data for a byte at offset
+ * POS. */
+static disk_sector_t
+byte_to_sector (struct inode *inode, off_t pos) {
+	uint32_t idx = pos / DISK_SECTOR_SIZE;
+	size_t lo = 0, hi = inode->data.extent_cnt;
+
+	ASSERT (inode != NULL);
+	if (pos >= inode->data.length)
+		return -1;
+
+	/* Find the last extent that starts at or before IDX. */
+	while (hi - lo > 1) {
+		size_t mid = (lo + hi) / 2;
+		if (extent_at (inode, mid)->ofs <= idx)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	ASSERT (idx - extent_at (inode, lo)->ofs < extent_at (inode, lo)->length);
+	return extent_at (inode, lo)->start + (idx - extent_at (inode, lo)->ofs);
+}
+
+/* Writes index block B of INODE to disk. */
+static void
+write_index_block (struct inode *inode, size_t b) {
+	struct index_disk *block = calloc (1, sizeof *block);
+	size_t first = b * INDEX_EXTENTS;
+	size_t cnt = inode->data.extent_cnt - INLINE_EXTENTS - first;
+
+	ASSERT (sizeof *block == DISK_SECTOR_SIZE);
+	if (block == NULL)
+		PANIC ("write_index_block: out of memory");
+	if (cnt > INDEX_EXTENTS)
+		cnt = INDEX_EXTENTS;
+	block->next = b + 1 < inode->block_cnt ? inode->blocks[b + 1] : 0;
+	memcpy (block->extents, inode->spill + first, cnt * sizeof *block->extents);
+	buffer_cache_write (inode->blocks[b], block, 0, DISK_SECTOR_SIZE);
+	free (block);
+}
+
+/* Appends an extent of LENGTH sectors at disk sector START to INODE,
+ * or lengthens its last extent if that one ends right before START.
+ * Writes the changed metadata.  Returns false if an index block is
+ * needed and cannot be had. */
+static bool
+add_extent (struct inode *inode, disk_sector_t start, size_t length) {
+	size_t cnt = inode->data.extent_cnt;
+	struct extent *last = cnt > 0 ? extent_at (inode, cnt - 1) : NULL;
+	struct extent e;
+
+	if (last != NULL && last->start + last->length == start) {
+		last->length += length;
+		if (cnt > INLINE_EXTENTS)
+			write_index_block (inode, (cnt - 1 - INLINE_EXTENTS) / INDEX_EXTENTS);
+		buffer_cache_write (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+		return true;
+	}
+
+	e.ofs = last != NULL ? last->ofs + last->length : 0;
+	e.start = start;
+	e.length = length;
+	if (cnt < INLINE_EXTENTS)
+		inode->data.extents[cnt] = e;
+	else {
+		size_t i = cnt - INLINE_EXTENTS;
+		size_t b = i / INDEX_EXTENTS;
+		struct extent *spill;
+
+		if (b == inode->block_cnt) {
+			/* Start a new index block and link it in. */
+			disk_sector_t *blocks;
+
+			spill = realloc (inode->spill, (b + 1) * INDEX_EXTENTS * sizeof *spill);
+			if (spill == NULL)
+				return false;
+			inode->spill = spill;
+			blocks = realloc (inode->blocks, (b + 1) * sizeof *blocks);
+			if (blocks == NULL)
+				return false;
+			inode->blocks = blocks;
+			if (!free_map_allocate (1, &blocks[b]))
+				return false;
+			inode->block_cnt++;
+			if (b == 0)
+				inode->data.index = blocks[b];
+			else
+				write_index_block (inode, b - 1);
+		}
+		inode->spill[i] = e;
+	}
+	inode->data.extent_cnt++;
+	if (cnt >= INLINE_EXTENTS)
+		write_index_block (inode, (cnt - INLINE_EXTENTS) / INDEX_EXTENTS);
+	buffer_cache_write (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+	return true;
+}
+
+/* Allocates sectors to INODE until it has at least SECTORS, preferring
+ * ones right after its last extent so that it stays contiguous.  New
+ * sectors are zeroed.  Returns false if the disk is full. */
+static bool
+inode_grow (struct inode *inode, size_t sectors) {
+	static char zeros[DISK_SECTOR_SIZE];
+	size_t have = allocated_sectors (inode);
+
+	while (have < sectors) {
+		size_t cnt = inode->data.extent_cnt;
+		struct extent *last = cnt > 0 ? extent_at (inode, cnt - 1) : NULL;
+		disk_sector_t hint = last != NULL ? last->start + last->length
+			: inode->sector + 1;
+		disk_sector_t start;
+		size_t got, i;
+
+		got = free_map_allocate_run (hint, sectors - have, &start);
+		if (got == 0)
+			return false;
+		for (i = 0; i < got; i++)
+			buffer_cache_write (start + i, zeros, 0, DISK_SECTOR_SIZE);
+		if (!add_extent (inode, start, got)) {
+			free_map_release (start, got);
+			return false;
+		}
+		have += got;
+	}
+	return true;
+}
+
+/* Releases every sector allocated to INODE's data and index blocks. */
+static void
+inode_release_blocks (struct inode *inode) {
+	size_t i;
+
+	for (i = 0; i < inode->data.extent_cnt; i++)
+		free_map_release (extent_at (inode, i)->start,
+				extent_at (inode, i)->length);
+	for (i = 0; i < inode->block_cnt; i++)
+		free_map_release (inode->blocks[i], 1);
+}
+
+/* Sets up INODE's in-memory extents after its on-disk inode has been
+ * read, reading its index blocks.  Returns false if memory runs
+ * out. */
+static bool
+inode_load (struct inode *inode) {
+	size_t spilled, b;
+	disk_sector_t next = inode->data.index;
+
+	inode->spill = NULL;
+	inode->blocks = NULL;
+	inode->block_cnt = 0;
+	if (inode->data.extent_cnt <= INLINE_EXTENTS)
+		return true;
+	spilled = inode->data.extent_cnt - INLINE_EXTENTS;
+	inode->block_cnt = DIV_ROUND_UP (spilled, INDEX_EXTENTS);
+	inode->blocks = malloc (inode->block_cnt * sizeof *inode->blocks);
+	inode->spill = malloc (inode->block_cnt * INDEX_EXTENTS
+			* sizeof *inode->spill);
+	if (inode->blocks == NULL || inode->spill == NULL)
+		return false;
+
+	for (b = 0; b < inode->block_cnt; b++) {
+		size_t first = b * INDEX_EXTENTS;
+		size_t cnt = spilled - first < INDEX_EXTENTS ? spilled - first
+			: INDEX_EXTENTS;
+
+		inode->blocks[b] = next;
+		buffer_cache_read (next, &inode->spill[first],
+				offsetof (struct index_disk, extents),
+				cnt * sizeof *inode->spill);
+		buffer_cache_read (next, &next, offsetof (struct index_disk, next),
+				sizeof next);
+	}
+	return true;
+}
+
+/* Frees INODE's in-memory extents. */
+static void
+inode_unload (struct inode *inode) {
+	free (inode->spill);
+	free (inode->blocks);
+}
+#else /* EFILESYS */
+/* Returns the number of file clusters covered by INODE's run cache. */
+static size_t
+runs_covered (const struct inode *inode) {
+	const struct cluster_run *last;
+
+	if (inode->run_cnt == 0)
+		return 0;
+	last = &inode->runs[inode->run_cnt - 1];
+	return last->ofs + last->length;
+}
+
+/* Adds disk cluster CLST to INODE's run cache as the next cluster of
+ * its chain.  Returns false if memory runs out. */
+static bool
+runs_append (struct inode *inode, cluster_t clst) {
+	struct cluster_run *last = inode->run_cnt > 0
+		? &inode->runs[inode->run_cnt - 1] : NULL;
+
+	if (last != NULL && last->start + last->length == clst) {
+		last->length++;
+		return true;
+	}
+	if (inode->run_cnt == inode->run_cap) {
+		size_t cap = inode->run_cap > 0 ? inode->run_cap * 2 : 4;
+		struct cluster_run *runs = realloc (inode->runs, cap * sizeof *runs);
+		if (runs == NULL)
+			return false;
+		inode->runs = runs;
+		inode->run_cap = cap;
+	}
+	inode->runs[inode->run_cnt].ofs = runs_covered (inode);
+	inode->runs[inode->run_cnt].start = clst;
+	inode->runs[inode->run_cnt].length = 1;
+	inode->run_cnt++;
+	return true;
+}
+
+/* Follows INODE's chain on from the part its run cache covers, adding
+ * to the cache, until it covers file cluster IDX or the chain ends.
+ * Stops early if memory runs out. */
+static void
+runs_extend (struct inode *inode, size_t idx) {
+	while (!inode->chain_end && runs_covered (inode) <= idx) {
+		cluster_t next;
+
+		if (inode->run_cnt == 0)
+			next = inode->data.start;
+		else {
+			struct cluster_run *last = &inode->runs[inode->run_cnt - 1];
+			next = fat_get (last->start + last->length - 1);
+		}
+		if (next == 0 || next == EOChain)
+			inode->chain_end = true;
+		else if (!runs_append (inode, next))
+			return;
+	}
+}
+
+/* Forgets INODE's run cache, after its chain has been freed. */
+static void
+runs_invalidate (struct inode *inode) {
+	inode->run_cnt = 0;
+	inode->chain_end = false;
+}
+
+/* Returns the disk cluster holding file cluster IDX of INODE, which
+ * must have that many, by binary search over its run cache.  Walks
+ * the chain itself if the cache cannot grow that far. */
+static cluster_t
+cluster_at (struct inode *inode, size_t idx) {
+	size_t lo = 0, hi;
+	cluster_t clst;
+
+	runs_extend (inode, idx);
+	if (idx >= runs_covered (inode)) {
+		/* Out of memory for the cache. */
+		for (clst = inode->data.start; idx > 0; idx--)
+			clst = fat_get (clst);
+		return clst;
+	}
+
+	/* Find the last run that starts at or before IDX. */
+	hi = inode->run_cnt;
+	while (hi - lo > 1) {
+		size_t mid = (lo + hi) / 2;
+		if (inode->runs[mid].ofs <= idx)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return inode->runs[lo].start + (idx - inode->runs[lo].ofs);
+}
+
+/* Returns the number of sectors allocated to INODE, which may be more
+ * than its length needs. */
+static size_t
+allocated_sectors (struct inode *inode) {
+	size_t cnt;
+	cluster_t clst;
+
+	runs_extend (inode, SIZE_MAX);
+	if (inode->chain_end)
+		return runs_covered (inode);
+
+	/* Out of memory for the cache. */
+	cnt = 0;
+	for (clst = inode->data.start; clst != 0 && clst != EOChain;
+			clst = fat_get (clst))
+		cnt++;
+	return cnt;
+}
+
 /* Returns the disk sector that contains byte offset POS within
  * INODE.
  * Returns -1 if INODE does not contain data for a byte at offset
  * POS. */
 static disk_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) {
+byte_to_sector (struct inode *inode, off_t pos) {
 	ASSERT (inode != NULL);
-	if (pos < inode->data.length)
-		return inode->data.start + pos / DISK_SECTOR_SIZE;
-	else
+	if (pos >= inode->data.length)
 		return -1;
+	return cluster_to_sector (cluster_at (inode, pos / DISK_SECTOR_SIZE));
+}
+
+/* Adds clusters to INODE's chain until it has at least SECTORS.  New
+ * clusters are zeroed.  Returns false if the disk is full. */
+static bool
+inode_grow (struct inode *inode, size_t sectors) {
+	static char zeros[DISK_SECTOR_SIZE];
+	size_t have = allocated_sectors (inode);
+	cluster_t last = have > 0 ? cluster_at (inode, have - 1) : 0;
+
+	for (; have < sectors; have++) {
+		cluster_t clst = fat_create_chain (last);
+
+		if (clst == 0)
+			return false;
+		buffer_cache_write (cluster_to_sector (clst), zeros, 0,
+				DISK_SECTOR_SIZE);
+		if (last == 0) {
+			inode->data.start = clst;
+			buffer_cache_write (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+		}
+		/* The chain grew past where the cache saw it end. */
+		inode->chain_end = false;
+		last = clst;
+	}
+	return true;
+}
+
+/* Releases every cluster of INODE's data. */
+static void
+inode_release_blocks (struct inode *inode) {
+	if (inode->data.start != 0) {
+		fat_remove_chain (inode->data.start, 0);
+		inode->data.start = 0;
+	}
+	runs_invalidate (inode);
+}
+
+/* Sets up INODE's run cache after its on-disk inode has been read.
+ * The cache fills in as the chain is followed. */
+static bool
+inode_load (struct inode *inode) {
+	inode->runs = NULL;
+	inode->run_cnt = inode->run_cap = 0;
+	inode->chain_end = false;
+	return true;
+}
+
+/* Frees INODE's run cache. */
+static void
+inode_unload (struct inode *inode) {
+	free (inode->runs);
+}
+#endif /* EFILESYS */
+
+/* Allocates a sector for a new inode and stores it in *SECTORP.  On
+ * FAT the inode gets a cluster, and so a chain, of its own.  Returns
+ * false if the disk is full. */
+bool
+inode_allocate_sector (disk_sector_t *sectorp) {
+#ifdef EFILESYS
+	cluster_t clst = fat_create_chain (0);
+
+	if (clst == 0)
+		return false;
+	*sectorp = cluster_to_sector (clst);
+	return true;
+#else
+	return free_map_allocate (1, sectorp);
+#endif
+}
+
+/* Releases SECTOR, which inode_allocate_sector() returned. */
+void
+inode_release_sector (disk_sector_t sector) {
+#ifdef EFILESYS
+	fat_remove_chain (sector_to_cluster (sector), 0);
+#else
+	free_map_release (sector, 1);
+#endif
 }
 
 /* List of open inodes, so that opening a single inode twice
@@ -76,6 +538,7 @@ inode_init (void) {
 bool
 inode_create (disk_sector_t sector, off_t length) {
 	struct inode_disk *disk_inode = NULL;
+	struct inode *inode;
 	bool success = false;
 
 	ASSERT (length >= 0);
@@ -86,21 +549,22 @@ inode_create (disk_sector_t sector, off_t length) {
 
 	disk_inode = calloc (1, sizeof *disk_inode);
 	if (disk_inode != NULL) {
-		size_t sectors = bytes_to_sectors (length);
-		disk_inode->length = length;
 		disk_inode->magic = INODE_MAGIC;
-		if (free_map_allocate (sectors, &disk_inode->start)) {
-			disk_write (filesys_disk, sector, disk_inode);
-			if (sectors > 0) {
-				static char zeros[DISK_SECTOR_SIZE];
-				size_t i;
-
-				for (i = 0; i < sectors; i++) 
-					disk_write (filesys_disk, disk_inode->start + i, zeros); 
-			}
-			success = true; 
-		} 
+		buffer_cache_write (sector, disk_inode, 0, DISK_SECTOR_SIZE);
 		free (disk_inode);
+
+		/* Allocate the data through an open inode, like a write
+		 * past the end would. */
+		inode = inode_open (sector);
+		if (inode != NULL) {
+			if (inode_grow (inode, bytes_to_sectors (length))) {
+				inode->data.length = length;
+				buffer_cache_write (sector, &inode->data, 0, DISK_SECTOR_SIZE);
+				success = true;
+			} else
+				inode_release_blocks (inode);
+			inode_close (inode);
+		}
 	}
 	return success;
 }
@@ -129,12 +593,17 @@ inode_open (disk_sector_t sector) {
 		return NULL;
 
 	/* Initialize. */
-	list_push_front (&open_inodes, &inode->elem);
 	inode->sector = sector;
 	inode->open_cnt = 1;
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
-	disk_read (filesys_disk, inode->sector, &inode->data);
+	buffer_cache_read (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+	if (!inode_load (inode)) {
+		inode_unload (inode);
+		free (inode);
+		return NULL;
+	}
+	list_push_front (&open_inodes, &inode->elem);
 	return inode;
 }
 
@@ -168,11 +637,11 @@ inode_close (struct inode *inode) {
 
 		/* Deallocate blocks if removed. */
 		if (inode->removed) {
-			free_map_release (inode->sector, 1);
-			free_map_release (inode->data.start,
-					bytes_to_sectors (inode->data.length)); 
+			inode_release_sector (inode->sector);
+			inode_release_blocks (inode);
 		}
 
+		inode_unload (inode);
 		free (inode); 
 	}
 }
@@ -192,7 +661,6 @@ off_t
 inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 	uint8_t *buffer = buffer_;
 	off_t bytes_read = 0;
-	uint8_t *bounce = NULL;
 
 	while (size > 0) {
 		/* Disk sector to read, starting byte offset within sector. */
@@ -210,45 +678,61 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 			break;
 
 		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Read full sector directly into caller's buffer. */
-			disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
-		} else {
-			/* Read sector into bounce buffer, then partially copy
-			 * into caller's buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-			disk_read (filesys_disk, sector_idx, bounce);
-			memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-		}
+			/* Read full sectors directly into caller's buffer, as
+			 * many as follow each other on disk at once. */
+			size_t cnt = 1;
+
+			while (cnt < DISK_MAX_MULTIPLE
+					&& size - (off_t) cnt * DISK_SECTOR_SIZE >= DISK_SECTOR_SIZE
+					&& inode_left - (off_t) cnt * DISK_SECTOR_SIZE >= DISK_SECTOR_SIZE
+					&& byte_to_sector (inode, offset + cnt * DISK_SECTOR_SIZE)
+						== sector_idx + cnt)
+				cnt++;
+			buffer_cache_read_sectors (sector_idx, cnt, buffer + bytes_read);
+			chunk_size = cnt * DISK_SECTOR_SIZE;
+		} else
+			buffer_cache_read (sector_idx, buffer + bytes_read, sector_ofs,
+					chunk_size);
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_read += chunk_size;
 	}
-	free (bounce);
 
 	return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
+ * A write past the end of file extends the inode, filling any gap
+ * with zeros.
  * Returns the number of bytes actually written, which may be
- * less than SIZE if end of file is reached or an error occurs.
- * (Normally a write at end of file would extend the inode, but
- * growth is not yet implemented.) */
+ * less than SIZE if the disk fills up or an error occurs. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		off_t offset) {
 	const uint8_t *buffer = buffer_;
 	off_t bytes_written = 0;
-	uint8_t *bounce = NULL;
 
 	if (inode->deny_write_cnt)
 		return 0;
 
+	/* Grow the file first, by at least GROW_SECTORS sectors, or by as
+	 * much as the disk has room for. */
+	if (offset + size > inode->data.length) {
+		size_t need = bytes_to_sectors (offset + size);
+
+		if (need > allocated_sectors (inode)
+				&& !inode_grow (inode, ROUND_UP (need, GROW_SECTORS)))
+			inode_grow (inode, need);
+		if ((off_t) allocated_sectors (inode) * DISK_SECTOR_SIZE < offset + size)
+			size = (off_t) allocated_sectors (inode) * DISK_SECTOR_SIZE - offset;
+		if (size > 0) {
+			inode->data.length = offset + size;
+			buffer_cache_write (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+		}
+	}
+
 	while (size > 0) {
 		/* Sector to write, starting byte offset within sector. */
 		disk_sector_t sector_idx = byte_to_sector (inode, offset);
@@ -264,34 +748,14 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		if (chunk_size <= 0)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Write full sector directly to disk. */
-			disk_write (filesys_disk, sector_idx, buffer + bytes_written); 
-		} else {
-			/* We need a bounce buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-
-			/* If the sector contains data before or after the chunk
-			   we're writing, then we need to read in the sector
-			   first.  Otherwise we start with a sector of all zeros. */
-			if (sector_ofs > 0 || chunk_size < sector_left) 
-				disk_read (filesys_disk, sector_idx, bounce);
-			else
-				memset (bounce, 0, DISK_SECTOR_SIZE);
-			memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-			disk_write (filesys_disk, sector_idx, bounce); 
-		}
+		buffer_cache_write (sector_idx, buffer + bytes_written, sector_ofs,
+				chunk_size);
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_written += chunk_size;
 	}
-	free (bounce);
 
 	return bytes_written;
 }
@@ -0,0 +1,17 @@
+#ifndef FILESYS_BUFFER_CACHE_H
+#define FILESYS_BUFFER_CACHE_H
+
+#include "devices/disk.h"
+
+/* Sectors held by the buffer cache. */
+#define BUFFER_CACHE_SIZE 64
+
+void buffer_cache_init (void);
+void buffer_cache_start_flushd (void);
+void buffer_cache_read (disk_sector_t, void *buffer, int ofs, int size);
+void buffer_cache_read_sectors (disk_sector_t, size_t cnt, void *buffer);
+void buffer_cache_write (disk_sector_t, const void *buffer, int ofs, int size);
+void buffer_cache_flush (void);
+void buffer_cache_print_stats (void);
+
+#endif /* filesys/buffer_cache.h */
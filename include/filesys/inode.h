@@ -8,6 +8,8 @@
 struct bitmap;
 
 void inode_init (void);
+bool inode_allocate_sector (disk_sector_t *);
+void inode_release_sector (disk_sector_t);
 bool inode_create (disk_sector_t, off_t);
 struct inode *inode_open (disk_sector_t);
 struct inode *inode_reopen (struct inode *);
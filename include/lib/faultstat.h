@@ -0,0 +1,34 @@
+#ifndef __LIB_FAULTSTAT_H
+#define __LIB_FAULTSTAT_H
+
+#include <stdint.h>
+
+/* What a page fault turned out to be. */
+enum fault_class {
+	FAULT_ELF,                  /* Lazy load of a program segment. */
+	FAULT_ZERO,                 /* Anonymous page filled with zeros. */
+	FAULT_FILE,                 /* Page of a mmapped file. */
+	FAULT_SWAP,                 /* Anonymous page brought back from swap. */
+	FAULT_STACK,                /* Page added by growing the stack. */
+	FAULT_COW,                  /* Write to a page shared copy-on-write. */
+	FAULT_INVALID,              /* Not a valid access; the process dies. */
+	FAULT_CLASS_CNT
+};
+
+/* Latency buckets: bucket I counts faults that took [2^I, 2^(I+1))
+   TSC cycles to handle.  The last bucket also takes anything
+   slower. */
+#define FAULT_HIST_BUCKETS 32
+
+/* Page faults taken by a process, or by all processes, as returned
+   by the faultstat system call. */
+struct faultstat {
+	uint64_t count[FAULT_CLASS_CNT];        /* Faults of each class. */
+	uint64_t cycles[FAULT_CLASS_CNT];       /* Total cycles spent on them. */
+	uint32_t hist[FAULT_CLASS_CNT][FAULT_HIST_BUCKETS];
+};
+
+/* Process ID that asks faultstat for the kernel-wide totals. */
+#define FAULTSTAT_ALL -1
+
+#endif /* lib/faultstat.h */
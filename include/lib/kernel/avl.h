@@ -0,0 +1,81 @@
+#ifndef __LIB_KERNEL_AVL_H
+#define __LIB_KERNEL_AVL_H
+
+/* Balanced binary search tree.
+ *
+ * This is an AVL tree: the heights of the two subtrees of every
+ * node differ by at most one, so lookups, insertions and
+ * deletions all take O(log n) time in the worst case.
+ *
+ * Like the list and hash table, the tree does not allocate
+ * memory.  Each structure that can be in a tree must embed a
+ * struct avl_elem member, and avl_entry converts a struct
+ * avl_elem back into the structure that contains it.  Elements
+ * are ordered by a caller-supplied comparison function; at most
+ * one element of each equivalence class may be in the tree.
+ *
+ * Besides exact lookups, avl_floor and avl_ceil find the nearest
+ * element on either side of a key, which is what range lookups
+ * (e.g. "which interval contains this address?") need. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Tree element. */
+struct avl_elem {
+	struct avl_elem *parent;    /* Parent, or NULL for the root. */
+	struct avl_elem *left;      /* Subtree of smaller elements. */
+	struct avl_elem *right;     /* Subtree of larger elements. */
+	int height;                 /* Height of the subtree rooted here. */
+};
+
+/* Converts pointer to tree element AVL_ELEM into a pointer to
+ * the structure that AVL_ELEM is embedded inside.  Supply the
+ * name of the outer structure STRUCT and the member name MEMBER
+ * of the tree element. */
+#define avl_entry(AVL_ELEM, STRUCT, MEMBER)           \
+	((STRUCT *) ((uint8_t *) (AVL_ELEM)           \
+		- offsetof (STRUCT, MEMBER)))
+
+/* Compares the value of two tree elements A and B, given
+ * auxiliary data AUX.  Returns true if A is less than B, or
+ * false if A is greater than or equal to B. */
+typedef bool avl_less_func (const struct avl_elem *a,
+		const struct avl_elem *b,
+		void *aux);
+
+/* Performs some operation on tree element E, given auxiliary
+ * data AUX. */
+typedef void avl_action_func (struct avl_elem *e, void *aux);
+
+/* Tree. */
+struct avl {
+	struct avl_elem *root;      /* Root element, or NULL if empty. */
+	size_t elem_cnt;            /* Number of elements in tree. */
+	avl_less_func *less;        /* Comparison function. */
+	void *aux;                  /* Auxiliary data for `less'. */
+};
+
+/* Basic life cycle. */
+void avl_init (struct avl *, avl_less_func *, void *aux);
+void avl_clear (struct avl *, avl_action_func *);
+
+/* Search, insertion, deletion. */
+struct avl_elem *avl_insert (struct avl *, struct avl_elem *);
+void avl_remove (struct avl *, struct avl_elem *);
+struct avl_elem *avl_find (struct avl *, const struct avl_elem *);
+struct avl_elem *avl_floor (struct avl *, const struct avl_elem *);
+struct avl_elem *avl_ceil (struct avl *, const struct avl_elem *);
+
+/* In-order traversal. */
+struct avl_elem *avl_first (struct avl *);
+struct avl_elem *avl_last (struct avl *);
+struct avl_elem *avl_next (struct avl_elem *);
+struct avl_elem *avl_prev (struct avl_elem *);
+
+/* Information. */
+size_t avl_size (struct avl *);
+bool avl_empty (struct avl *);
+
+#endif /* lib/kernel/avl.h */
@@ -0,0 +1,33 @@
+#ifndef __LIB_KERNEL_LZ_H
+#define __LIB_KERNEL_LZ_H
+
+/* Fast LZ77 compression.
+ *
+ * The output is a sequence of records, each made of a run of
+ * literal bytes followed by a back-reference (offset, length) to
+ * data already produced.  The last record has literals only.  A
+ * record starts with a token byte whose high nibble is the literal
+ * count and low nibble is the match length minus LZ_MIN_MATCH; a
+ * nibble of 15 is extended by following bytes, each adding up to
+ * 255.  This is the layout of an LZ4 block.
+ *
+ * Matches are found through a hash table of recent positions, so
+ * compression is a single pass and decompression is a plain copy
+ * loop.  The table is supplied by the caller, since it is too big
+ * for a kernel stack. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Shortest back-reference worth encoding. */
+#define LZ_MIN_MATCH 4
+
+/* Number of entries in the work table for lz_compress(). */
+#define LZ_TABLE_SIZE 4096
+
+size_t lz_compress (const void *src, size_t src_len, void *dst, size_t dst_cap,
+		uint16_t table[LZ_TABLE_SIZE]);
+size_t lz_decompress (const void *src, size_t src_len, void *dst,
+		size_t dst_cap);
+
+#endif /* lib/kernel/lz.h */
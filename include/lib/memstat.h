@@ -0,0 +1,18 @@
+#ifndef __LIB_MEMSTAT_H
+#define __LIB_MEMSTAT_H
+
+#include <stddef.h>
+
+/* Memory usage of a process, as returned by the memstat system
+   call.  All counts are in pages, except KERNEL, which is in
+   bytes. */
+struct memstat {
+	size_t resident;            /* User pages currently held in a frame. */
+	size_t resident_peak;       /* High-water mark of RESIDENT. */
+	size_t page_tables;         /* pml4 and lower-level page table pages. */
+	size_t swapped;             /* Anonymous pages held on the swap disk. */
+	size_t mmap;                /* Resident pages of mmaped files. */
+	size_t kernel;              /* Kernel memory owned by the process. */
+};
+
+#endif /* lib/memstat.h */
@@ -0,0 +1,8 @@
+#ifndef __LIB_MMAP_H
+#define __LIB_MMAP_H
+
+/* Pass as the file descriptor to the mmap system call for
+   anonymous, zero-filled memory not backed by any file. */
+#define MAP_ANONYMOUS (-1)
+
+#endif /* lib/mmap.h */
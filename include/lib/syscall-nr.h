@@ -36,6 +36,14 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Memory management extensions. */
+	SYS_MEMSTAT,                /* Report a process's memory usage. */
+	SYS_MADVISE,                /* Give advice about use of memory. */
+	SYS_FAULTSTAT,              /* Report a process's page faults. */
+	SYS_MSYNC,                  /* Write a file mapping back to its file. */
+	SYS_SPAWN,                  /* Start a new process running a program. */
+	SYS_SBRK,                   /* Move the program break. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -4,6 +4,11 @@
 #include <stdbool.h>
 #include <debug.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <faultstat.h>
+#include <madvise.h>
+#include <mmap.h>
+#include <memstat.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -25,6 +30,7 @@ void halt (void) NO_RETURN;
 void exit (int status) NO_RETURN;
 pid_t fork (const char *thread_name);
 int exec (const char *file);
+pid_t spawn (const char *file);
 int wait (pid_t);
 bool create (const char *file, unsigned initial_size);
 bool remove (const char *file);
@@ -50,6 +56,13 @@ bool isdir (int fd);
 int inumber (int fd);
 int symlink (const char* target, const char* linkpath);
 
+/* Memory management extensions. */
+int memstat (pid_t pid, struct memstat *);
+int madvise (void *addr, size_t length, int advice);
+int faultstat (pid_t pid, struct faultstat *);
+int msync (void *addr, size_t length);
+void *sbrk (intptr_t increment);
+
 static inline void* get_phys_addr (void *user_addr) {
 	void* pa;
 	asm volatile ("movq %0, %%rax" ::"r"(user_addr));
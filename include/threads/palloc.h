@@ -19,5 +19,10 @@ void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+void palloc_share_page (void *);
+size_t palloc_page_refcnt (void *);
+size_t palloc_free_cnt (enum palloc_flags);
+size_t palloc_pool_size (enum palloc_flags);
+void palloc_print_stats (void);
 
 #endif /* threads/palloc.h */
@@ -4,6 +4,7 @@
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
+#include <memstat.h>
 #include "threads/interrupt.h"
 #include "threads/synch.h" /** project2-System Call */
 #ifdef VM
@@ -123,6 +124,7 @@ struct thread {
 	uint64_t *pml4;                     /* Page map level 4 */
 	/** project2-System Call */
 	int exit_status;
+	bool is_process;         // initd나 fork로 만든 사용자 프로세스인지
 
 	int fd_idx;              // 파일 디스크립터 인덱스
     struct file **fdt;       // 파일 디스크립터 테이블
@@ -133,8 +135,12 @@ struct thread {
     struct list_elem child_elem;
 
 	struct semaphore fork_sema;  // fork가 완료될 때 signal
+	bool fork_ok;                // fork_sema를 올리기 전에 복제 성공 여부를 기록
     struct semaphore exit_sema;  // 자식 프로세스 종료 signal
     struct semaphore wait_sema;  // exit_sema를 기다릴 때 사용
+
+	struct memstat mem;          // 메모리 사용량 (userprog/memstat.c)
+	struct faultstat *faults;    // 페이지 폴트 통계 (userprog/faultstat.c)
 // #endif
 
 #ifdef VM
@@ -193,6 +199,7 @@ void thread_unblock (struct thread *);
 
 struct thread *thread_current (void);
 tid_t thread_tid (void);
+struct thread *thread_find (tid_t);
 const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
@@ -0,0 +1,13 @@
+#ifndef USERPROG_FAULTSTAT_H
+#define USERPROG_FAULTSTAT_H
+
+#include <faultstat.h>
+#include "threads/thread.h"
+
+void faultstat_init (struct thread *);
+void faultstat_record (enum fault_class, uint64_t cycles);
+void faultstat_release (struct thread *);
+bool faultstat_get (tid_t, struct faultstat *);
+void faultstat_print_stats (void);
+
+#endif /* userprog/faultstat.h */
@@ -0,0 +1,22 @@
+#ifndef USERPROG_MEMSTAT_H
+#define USERPROG_MEMSTAT_H
+
+#include <memstat.h>
+#include "threads/thread.h"
+
+/* Per-process memory counters.  Each one is kept in the owning
+ * thread's `struct memstat' and summed into a kernel-wide total. */
+enum memstat_counter {
+	MEMSTAT_RESIDENT,           /* User pages mapped to a frame. */
+	MEMSTAT_PAGE_TABLES,        /* Page table pages. */
+	MEMSTAT_SWAPPED,            /* Pages on the swap disk. */
+	MEMSTAT_MMAP,               /* Resident file-backed pages. */
+	MEMSTAT_KERNEL,             /* Kernel objects, in bytes. */
+};
+
+void memstat_charge (struct thread *, enum memstat_counter, long amount);
+void memstat_release (struct thread *);
+bool memstat_get (tid_t, struct memstat *);
+void memstat_print_stats (void);
+
+#endif /* userprog/memstat.h */
@@ -6,8 +6,12 @@
 tid_t process_create_initd (const char *file_name);
 tid_t process_fork (const char *name, struct intr_frame *if_);
 int process_exec (void *f_name);
+tid_t process_spawn (const char *cmdline);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (struct thread *next);
+#ifndef VM
+bool process_handle_cow (void *addr);
+#endif
 
 #endif /* userprog/process.h */
@@ -1,13 +1,18 @@
 #ifndef VM_ANON_H
 #define VM_ANON_H
+#include <stddef.h>
 #include "vm/vm.h"
 struct page;
 enum vm_type;
+struct zswap_entry;
 
 struct anon_page {
+	size_t slot;                /* Swap slot, or SWAP_ERROR if none. */
+	struct zswap_entry *zentry; /* Compressed copy, or NULL if none. */
 };
 
 void vm_anon_init (void);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
+void *do_mmap_anon (void *addr, size_t length, bool writable);
 
 #endif
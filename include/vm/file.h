@@ -7,6 +7,9 @@ struct page;
 enum vm_type;
 
 struct file_page {
+	struct file *file;          /* Backing file, owned by the area. */
+	off_t offset;               /* Offset of the page in FILE. */
+	size_t read_bytes;          /* Bytes of the page backed by FILE. */
 };
 
 void vm_file_init (void);
@@ -0,0 +1,11 @@
+#ifndef VM_FLUSHD_H
+#define VM_FLUSHD_H
+#include <stdint.h>
+
+/* Timer ticks between passes of the flush daemon.  Zero disables
+ * it. */
+extern int64_t flushd_ticks;
+
+void flushd_init (void);
+
+#endif /* vm/flushd.h */
@@ -0,0 +1,11 @@
+#ifndef VM_KSM_H
+#define VM_KSM_H
+#include <stddef.h>
+
+/* Frames looked at by each pass of the merging daemon.  Zero
+ * disables it. */
+extern size_t ksm_scan_pages;
+
+void ksm_init (void);
+
+#endif /* vm/ksm.h */
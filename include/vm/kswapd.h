@@ -0,0 +1,14 @@
+#ifndef VM_KSWAPD_H
+#define VM_KSWAPD_H
+#include <stdint.h>
+#include <stddef.h>
+
+/* Free user pages below which kswapd starts reclaiming.  It stops at
+ * twice as many.  Zero disables it; SIZE_MAX, the default, picks
+ * 1/32 of the user pool. */
+extern size_t kswapd_low_pages;
+
+void kswapd_init (void);
+void kswapd_wake (void);
+
+#endif /* vm/kswapd.h */
@@ -0,0 +1,20 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+#include <stdbool.h>
+#include <stddef.h>
+
+struct disk;
+
+/* Returned by swap_write() when swap space is exhausted. */
+#define SWAP_ERROR ((size_t) -1)
+
+/* Pages read or written by one swap disk command, at most. */
+#define SWAP_CLUSTER 16
+
+void swap_init (struct disk *);
+size_t swap_write (const void *kva);
+void swap_read (size_t slot, void *kva, size_t first, size_t cnt);
+void swap_free (size_t slot);
+void swap_print_stats (void);
+
+#endif /* vm/swap.h */
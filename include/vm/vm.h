@@ -1,6 +1,11 @@
 #ifndef VM_VM_H
 #define VM_VM_H
 #include <stdbool.h>
+#include <stdint.h>
+#include <avl.h>
+#include <faultstat.h>
+#include <hash.h>
+#include <list.h>
 #include "threads/palloc.h"
 
 enum vm_type {
@@ -33,6 +38,7 @@ enum vm_type {
 
 struct page_operations;
 struct thread;
+struct vma;
 
 #define VM_TYPE(type) ((type) & 7)
 
@@ -46,6 +52,12 @@ struct page {
 	struct frame *frame;   /* Back reference for frame */
 
 	/* Your implementation */
+	struct hash_elem spt_elem;  /* Element in spt->pages. */
+	struct list_elem vma_elem;  /* Element in vma->pages. */
+	struct list_elem frame_elem; /* Element in frame->pages. */
+	struct vma *vma;            /* Area that contains VA. */
+	struct thread *owner;       /* Process whose pml4 maps VA. */
+	bool writable;
 
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -62,7 +74,24 @@ struct page {
 /* The representation of "frame" */
 struct frame {
 	void *kva;
-	struct page *page;
+	struct list pages;          /* Pages mapped to this frame. */
+	size_t refcnt;              /* Number of pages in PAGES. */
+	struct list_elem elem;      /* Element in the frame table's clock ring. */
+	bool pinned;                /* Not to be evicted while set. */
+	bool evicting;              /* Its page is being written out. */
+	bool writing;               /* Its page is being written back. */
+
+	/* Shared text: where the page in the frame comes from, if the
+	 * frame is in the shared text table. */
+	struct inode *inode;        /* Backing inode, or NULL. */
+	off_t ofs;                  /* Offset of the page in INODE. */
+	size_t read_bytes;          /* Bytes of the page read from INODE. */
+	struct hash_elem text_elem; /* Element in the shared text table. */
+
+	/* Same-page merging. */
+	bool merged;                /* In the merged table, mapped read-only. */
+	uint64_t checksum;          /* Contents hash when last scanned. */
+	struct hash_elem merge_elem; /* Element in the merged table. */
 };
 
 /* The function table for page operations.
@@ -81,10 +110,42 @@ struct page_operations {
 #define destroy(page) \
 	if ((page)->operations->destroy) (page)->operations->destroy (page)
 
+/* Flags for struct vma. */
+#define VMA_STACK 0x1           /* Grows down when faulted just below. */
+#define VMA_TEXT 0x2            /* Read-only program segment, shared. */
+#define VMA_RANDOM 0x4          /* madvise(): no read-ahead. */
+#define VMA_SEQUENTIAL 0x8      /* madvise(): read ahead, drop behind. */
+#define VMA_HEAP 0x10           /* Program break, moved by sbrk(). */
+#define VMA_MMAP 0x20           /* Anonymous mmap(), removed by munmap(). */
+
+/* A virtual memory area: the pages [START, END) share one backing
+ * and one protection.  The first READ_BYTES bytes come from FILE at
+ * OFFSET and the rest are zero-filled.  A struct page is created for
+ * a page of the area only once it is faulted in, so an area costs
+ * the same however many pages it spans. */
+struct vma {
+	struct avl_elem elem;       /* Element in spt->vmas, keyed by START. */
+	void *start;                /* First page of the area. */
+	void *end;                  /* One past the last page. */
+	enum vm_type type;          /* VM_ANON or VM_FILE, with markers. */
+	bool writable;
+	unsigned flags;             /* VMA_* flags. */
+	struct file *file;          /* Own reference to the backing file. */
+	off_t offset;               /* Offset of START in FILE. */
+	size_t read_bytes;          /* Bytes of FILE mapped at START. */
+	struct list pages;          /* Pages of this area that exist. */
+};
+
 /* Representation of current process's memory space.
- * We don't want to force you to obey any specific design for this struct.
- * All designs up to you for this. */
+ * Areas live in a balanced tree ordered by start address, so finding
+ * the area of a fault takes O(log areas).  Pages that are resident
+ * or swapped out are also hashed by address. */
 struct supplemental_page_table {
+	struct avl vmas;            /* Areas ordered by start address. */
+	struct hash pages;          /* Pages keyed by VA. */
+	struct vma *hint;           /* Area of the most recent lookup. */
+	void *heap_start;           /* Start of the heap, or NULL if none. */
+	void *brk;                  /* Current program break. */
 };
 
 #include "threads/thread.h"
@@ -96,16 +157,44 @@ struct page *spt_find_page (struct supplemental_page_table *spt,
 		void *va);
 bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page (struct supplemental_page_table *spt, struct page *page);
+struct vma *spt_find_vma (struct supplemental_page_table *spt, void *va);
+
+bool vm_map (void *start, size_t length, enum vm_type type, bool writable,
+		unsigned flags, struct file *file, off_t offset, size_t read_bytes);
+void vm_unmap (struct supplemental_page_table *spt, struct vma *vma);
+bool vm_madvise (void *addr, size_t length, int advice);
+bool vm_msync (void *addr, size_t length);
+void vm_heap_init (void);
+void *vm_sbrk (intptr_t increment);
+void *vm_find_gap (size_t length);
+void vma_page_extent (const struct vma *vma, const void *va,
+		off_t *ofs, size_t *read_bytes);
+
+/* Pages mapped per fault in file-backed areas, counting the one that
+ * faulted.  1 disables fault-around. */
+extern size_t fault_around_pages;
+
+/* Programs whose loadable segments span at most this many pages are
+ * read in whole at exec.  0 disables prefaulting. */
+extern size_t exec_prefault_pages;
 
 void vm_init (void);
+void vm_merge_scan (size_t cnt);
+void vm_writeback (void);
+bool vm_reclaim_frame (void);
+void vm_print_stats (void);
 bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 		bool write, bool not_present);
+bool vm_handle_fault (struct intr_frame *f, void *addr, bool user,
+		bool write, bool not_present, enum fault_class *);
 
 #define vm_alloc_page(type, upage, writable) \
 	vm_alloc_page_with_initializer ((type), (upage), (writable), NULL, NULL)
 bool vm_alloc_page_with_initializer (enum vm_type type, void *upage,
 		bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page (struct page *page);
+void vm_free_frame (struct page *page);
+void vm_wait_io (struct page *page);
 bool vm_claim_page (void *va);
 enum vm_type page_get_type (struct page *page);
 
@@ -0,0 +1,17 @@
+#ifndef VM_ZSWAP_H
+#define VM_ZSWAP_H
+#include <stdbool.h>
+#include <stddef.h>
+
+struct page;
+
+/* Size of the compressed page pool, in pages.  Zero disables it. */
+extern size_t zswap_pool_pages;
+
+void zswap_init (void);
+bool zswap_store (struct page *);
+bool zswap_load (struct page *, void *kva);
+void zswap_invalidate (struct page *);
+void zswap_print_stats (void);
+
+#endif /* vm/zswap.h */
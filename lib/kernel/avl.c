@@ -0,0 +1,322 @@
+/* Balanced binary search tree.
+
+   See avl.h for basic information. */
+
+#include "avl.h"
+#include "../debug.h"
+
+static int height (const struct avl_elem *);
+static void update_height (struct avl_elem *);
+static void replace_child (struct avl *, struct avl_elem *parent,
+		struct avl_elem *old, struct avl_elem *new);
+static struct avl_elem *rotate_left (struct avl *, struct avl_elem *);
+static struct avl_elem *rotate_right (struct avl *, struct avl_elem *);
+static void rebalance (struct avl *, struct avl_elem *);
+
+/* Initializes tree T to order elements using LESS, given
+   auxiliary data AUX. */
+void
+avl_init (struct avl *t, avl_less_func *less, void *aux) {
+	ASSERT (t != NULL);
+	ASSERT (less != NULL);
+
+	t->root = NULL;
+	t->elem_cnt = 0;
+	t->less = less;
+	t->aux = aux;
+}
+
+/* Removes all the elements from T.
+
+   If DESTRUCTOR is non-null, then it is called for each element
+   in the tree.  DESTRUCTOR may, if appropriate, deallocate the
+   memory used by the tree element.  However, modifying tree T
+   while avl_clear() is running, using any of the functions
+   avl_clear(), avl_insert(), or avl_remove(), yields undefined
+   behavior, whether done in DESTRUCTOR or elsewhere.
+
+   Elements are visited children first, so this takes O(n)
+   time and does no rebalancing. */
+void
+avl_clear (struct avl *t, avl_action_func *destructor) {
+	struct avl_elem *e = t->root;
+
+	while (e != NULL) {
+		if (e->left != NULL)
+			e = e->left;
+		else if (e->right != NULL)
+			e = e->right;
+		else {
+			struct avl_elem *parent = e->parent;
+
+			if (parent != NULL) {
+				if (parent->left == e)
+					parent->left = NULL;
+				else
+					parent->right = NULL;
+			}
+			if (destructor != NULL)
+				destructor (e, t->aux);
+			e = parent;
+		}
+	}
+	t->root = NULL;
+	t->elem_cnt = 0;
+}
+
+/* Inserts NEW into tree T and returns a null pointer, if no
+   equal element is already in the tree.
+   If an equal element is already in the tree, returns it
+   without inserting NEW. */
+struct avl_elem *
+avl_insert (struct avl *t, struct avl_elem *new) {
+	struct avl_elem **link = &t->root;
+	struct avl_elem *parent = NULL;
+
+	while (*link != NULL) {
+		parent = *link;
+		if (t->less (new, parent, t->aux))
+			link = &parent->left;
+		else if (t->less (parent, new, t->aux))
+			link = &parent->right;
+		else
+			return parent;
+	}
+
+	new->parent = parent;
+	new->left = new->right = NULL;
+	new->height = 1;
+	*link = new;
+	t->elem_cnt++;
+	rebalance (t, parent);
+	return NULL;
+}
+
+/* Removes element E, which must be in tree T. */
+void
+avl_remove (struct avl *t, struct avl_elem *e) {
+	struct avl_elem *retrace;
+
+	if (e->left != NULL && e->right != NULL) {
+		/* Put E's in-order successor S in E's place.  S has no
+		   left child, so it can be unlinked from its old
+		   position directly. */
+		struct avl_elem *s = e->right;
+		while (s->left != NULL)
+			s = s->left;
+
+		if (s->parent == e)
+			retrace = s;
+		else {
+			retrace = s->parent;
+			replace_child (t, s->parent, s, s->right);
+			s->right = e->right;
+			s->right->parent = s;
+		}
+		s->left = e->left;
+		s->left->parent = s;
+		s->height = e->height;
+		replace_child (t, e->parent, e, s);
+	} else {
+		retrace = e->parent;
+		replace_child (t, e->parent, e, e->left != NULL ? e->left : e->right);
+	}
+
+	t->elem_cnt--;
+	rebalance (t, retrace);
+}
+
+/* Finds and returns an element equal to KEY in tree T, or a
+   null pointer if no equal element exists in the tree. */
+struct avl_elem *
+avl_find (struct avl *t, const struct avl_elem *key) {
+	struct avl_elem *e = avl_floor (t, key);
+	return e != NULL && !t->less (e, key, t->aux) ? e : NULL;
+}
+
+/* Returns the greatest element in T that is less than or equal
+   to KEY, or a null pointer if every element is greater. */
+struct avl_elem *
+avl_floor (struct avl *t, const struct avl_elem *key) {
+	struct avl_elem *e = t->root;
+	struct avl_elem *best = NULL;
+
+	while (e != NULL) {
+		if (t->less (key, e, t->aux))
+			e = e->left;
+		else {
+			best = e;
+			e = e->right;
+		}
+	}
+	return best;
+}
+
+/* Returns the least element in T that is greater than or equal
+   to KEY, or a null pointer if every element is less. */
+struct avl_elem *
+avl_ceil (struct avl *t, const struct avl_elem *key) {
+	struct avl_elem *e = t->root;
+	struct avl_elem *best = NULL;
+
+	while (e != NULL) {
+		if (t->less (e, key, t->aux))
+			e = e->right;
+		else {
+			best = e;
+			e = e->left;
+		}
+	}
+	return best;
+}
+
+/* Returns the least element in T, or a null pointer if T is
+   empty. */
+struct avl_elem *
+avl_first (struct avl *t) {
+	struct avl_elem *e = t->root;
+
+	if (e != NULL)
+		while (e->left != NULL)
+			e = e->left;
+	return e;
+}
+
+/* Returns the greatest element in T, or a null pointer if T is
+   empty. */
+struct avl_elem *
+avl_last (struct avl *t) {
+	struct avl_elem *e = t->root;
+
+	if (e != NULL)
+		while (e->right != NULL)
+			e = e->right;
+	return e;
+}
+
+/* Returns the element that follows E in order, or a null
+   pointer if E is the greatest element of its tree. */
+struct avl_elem *
+avl_next (struct avl_elem *e) {
+	if (e->right != NULL) {
+		e = e->right;
+		while (e->left != NULL)
+			e = e->left;
+		return e;
+	}
+	while (e->parent != NULL && e->parent->right == e)
+		e = e->parent;
+	return e->parent;
+}
+
+/* Returns the element that precedes E in order, or a null
+   pointer if E is the least element of its tree. */
+struct avl_elem *
+avl_prev (struct avl_elem *e) {
+	if (e->left != NULL) {
+		e = e->left;
+		while (e->right != NULL)
+			e = e->right;
+		return e;
+	}
+	while (e->parent != NULL && e->parent->left == e)
+		e = e->parent;
+	return e->parent;
+}
+
+/* Returns the number of elements in T. */
+size_t
+avl_size (struct avl *t) {
+	return t->elem_cnt;
+}
+
+/* Returns true if T contains no elements, false otherwise. */
+bool
+avl_empty (struct avl *t) {
+	return t->elem_cnt == 0;
+}
+
+/* Returns the height of the subtree rooted at E. */
+static int
+height (const struct avl_elem *e) {
+	return e != NULL ? e->height : 0;
+}
+
+/* Recomputes E's height from its children's. */
+static void
+update_height (struct avl_elem *e) {
+	int l = height (e->left);
+	int r = height (e->right);
+	e->height = (l > r ? l : r) + 1;
+}
+
+/* Makes NEW take OLD's place as a child of PARENT, or as the root
+   of T if PARENT is null. */
+static void
+replace_child (struct avl *t, struct avl_elem *parent,
+		struct avl_elem *old, struct avl_elem *new) {
+	if (parent == NULL)
+		t->root = new;
+	else if (parent->left == old)
+		parent->left = new;
+	else
+		parent->right = new;
+	if (new != NULL)
+		new->parent = parent;
+}
+
+/* Rotates the subtree rooted at X to the left and returns its
+   new root. */
+static struct avl_elem *
+rotate_left (struct avl *t, struct avl_elem *x) {
+	struct avl_elem *y = x->right;
+
+	replace_child (t, x->parent, x, y);
+	x->right = y->left;
+	if (y->left != NULL)
+		y->left->parent = x;
+	y->left = x;
+	x->parent = y;
+	update_height (x);
+	update_height (y);
+	return y;
+}
+
+/* Rotates the subtree rooted at X to the right and returns its
+   new root. */
+static struct avl_elem *
+rotate_right (struct avl *t, struct avl_elem *x) {
+	struct avl_elem *y = x->left;
+
+	replace_child (t, x->parent, x, y);
+	x->left = y->right;
+	if (y->right != NULL)
+		y->right->parent = x;
+	y->right = x;
+	x->parent = y;
+	update_height (x);
+	update_height (y);
+	return y;
+}
+
+/* Walks from E up to the root of T, restoring the height
+   invariant at each step. */
+static void
+rebalance (struct avl *t, struct avl_elem *e) {
+	while (e != NULL) {
+		int balance;
+
+		update_height (e);
+		balance = height (e->left) - height (e->right);
+		if (balance > 1) {
+			if (height (e->left->left) < height (e->left->right))
+				rotate_left (t, e->left);
+			e = rotate_right (t, e);
+		} else if (balance < -1) {
+			if (height (e->right->right) < height (e->right->left))
+				rotate_right (t, e->right);
+			e = rotate_left (t, e);
+		}
+		e = e->parent;
+	}
+}
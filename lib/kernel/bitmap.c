@@ -263,6 +263,28 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt) {
 
 /* Finding set or unset bits. */
 
+/* Returns the index of the first bit in B at or after START that
+   is set to VALUE, or BITMAP_ERROR if there is none.  Looks at a
+   whole element at a time. */
+static size_t
+scan_bit (const struct bitmap *b, size_t start, bool value) {
+	size_t i = start;
+
+	while (i < b->bit_cnt) {
+		elem_type e = b->bits[elem_idx (i)];
+
+		if (!value)
+			e = ~e;
+		e &= (elem_type) -1 << (i % ELEM_BITS);
+		if (e != 0) {
+			i = elem_idx (i) * ELEM_BITS + __builtin_ctzl (e);
+			return i < b->bit_cnt ? i : BITMAP_ERROR;
+		}
+		i = (elem_idx (i) + 1) * ELEM_BITS;
+	}
+	return BITMAP_ERROR;
+}
+
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
@@ -272,12 +294,25 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) {
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 
+	if (cnt == 0)
+		return start;
 	if (cnt <= b->bit_cnt) {
 		size_t last = b->bit_cnt - cnt;
-		size_t i;
-		for (i = start; i <= last; i++)
-			if (!bitmap_contains (b, i, cnt, !value))
+		size_t i = start;
+
+		/* Jump from each bit set to VALUE to the next one past the
+		   first bit in its group that is not. */
+		while (i <= last) {
+			size_t j;
+
+			i = scan_bit (b, i, value);
+			if (i == BITMAP_ERROR || i > last)
+				break;
+			j = scan_bit (b, i, !value);
+			if (j == BITMAP_ERROR || j >= i + cnt)
 				return i;
+			i = j + 1;
+		}
 	}
 	return BITMAP_ERROR;
 }
@@ -0,0 +1,167 @@
+/* Fast LZ77 compression.
+
+   See lz.h for basic information. */
+
+#include "lz.h"
+#include <stdbool.h>
+#include <string.h>
+#include "../debug.h"
+
+/* Longest offset a record can encode. */
+#define MAX_OFFSET 0xffff
+
+static uint32_t
+read32 (const uint8_t *p) {
+	uint32_t v;
+	memcpy (&v, p, sizeof v);
+	return v;
+}
+
+/* Hashes four bytes to an index into the work table. */
+static size_t
+hash32 (uint32_t v) {
+	return (v * 2654435761u) >> (32 - 12);
+}
+
+/* Writes length LEN, whose first 15 were counted in the token, as
+   extension bytes at *OP. */
+static void
+put_length (uint8_t **op, size_t len) {
+	for (len -= 15; len >= 255; len -= 255)
+		*(*op)++ = 255;
+	*(*op)++ = len;
+}
+
+/* Appends a record to *OP with LIT_LEN literals from LIT and, if
+   MATCH_LEN is nonzero, a match of MATCH_LEN bytes at OFFSET.
+   Returns false without writing if it would pass END. */
+static bool
+put_record (uint8_t **op, uint8_t *end, const uint8_t *lit, size_t lit_len,
+		size_t offset, size_t match_len) {
+	size_t ml = match_len != 0 ? match_len - LZ_MIN_MATCH : 0;
+	size_t worst = 1 + lit_len / 255 + 1 + lit_len + 2 + ml / 255 + 1;
+	uint8_t *token;
+
+	if ((size_t) (end - *op) < worst)
+		return false;
+
+	token = (*op)++;
+	*token = (lit_len < 15 ? lit_len : 15) << 4;
+	if (lit_len >= 15)
+		put_length (op, lit_len);
+	memcpy (*op, lit, lit_len);
+	*op += lit_len;
+
+	if (match_len != 0) {
+		*(*op)++ = offset & 0xff;
+		*(*op)++ = offset >> 8;
+		*token |= ml < 15 ? ml : 15;
+		if (ml >= 15)
+			put_length (op, ml);
+	}
+	return true;
+}
+
+/* Compresses SRC_LEN bytes at SRC into DST, which has room for
+   DST_CAP bytes, using TABLE as scratch space.  Returns the
+   compressed length, or 0 if the result would not fit. */
+size_t
+lz_compress (const void *src_, size_t src_len, void *dst_, size_t dst_cap,
+		uint16_t table[LZ_TABLE_SIZE]) {
+	const uint8_t *src = src_;
+	uint8_t *dst = dst_;
+	uint8_t *op = dst;
+	uint8_t *end = dst + dst_cap;
+	size_t anchor = 0;
+	size_t i = 0;
+
+	ASSERT (src_len <= MAX_OFFSET);
+
+	/* Stale entries are harmless: every candidate is verified. */
+	memset (table, 0, LZ_TABLE_SIZE * sizeof *table);
+	while (i + LZ_MIN_MATCH <= src_len) {
+		uint32_t seq = read32 (src + i);
+		size_t h = hash32 (seq);
+		size_t cand = table[h];
+
+		table[h] = i;
+		if (cand < i && read32 (src + cand) == seq) {
+			size_t len = LZ_MIN_MATCH;
+
+			while (i + len < src_len && src[cand + len] == src[i + len])
+				len++;
+			if (!put_record (&op, end, src + anchor, i - anchor, i - cand, len))
+				return 0;
+			i += len;
+			anchor = i;
+		} else
+			i++;
+	}
+	if (!put_record (&op, end, src + anchor, src_len - anchor, 0, 0))
+		return 0;
+	return op - dst;
+}
+
+/* Reads a length extension from *IP, not past END, and adds it to
+   *LEN.  Returns false on truncated input. */
+static bool
+get_length (const uint8_t **ip, const uint8_t *end, size_t *len) {
+	uint8_t b;
+
+	do {
+		if (*ip >= end)
+			return false;
+		b = *(*ip)++;
+		*len += b;
+	} while (b == 255);
+	return true;
+}
+
+/* Decompresses SRC_LEN bytes at SRC into DST, which has room for
+   DST_CAP bytes.  Returns the decompressed length, or 0 if the
+   input is malformed or does not fit. */
+size_t
+lz_decompress (const void *src_, size_t src_len, void *dst_,
+		size_t dst_cap) {
+	const uint8_t *ip = src_;
+	const uint8_t *iend = ip + src_len;
+	uint8_t *dst = dst_;
+	uint8_t *op = dst;
+	uint8_t *oend = dst + dst_cap;
+
+	while (ip < iend) {
+		uint8_t token = *ip++;
+		size_t len = token >> 4;
+		size_t offset;
+		const uint8_t *match;
+
+		if (len == 15 && !get_length (&ip, iend, &len))
+			return 0;
+		if (len > (size_t) (iend - ip) || len > (size_t) (oend - op))
+			return 0;
+		memcpy (op, ip, len);
+		op += len;
+		ip += len;
+		if (ip == iend)
+			break;
+
+		if (iend - ip < 2)
+			return 0;
+		offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > (size_t) (op - dst))
+			return 0;
+
+		len = token & 15;
+		if (len == 15 && !get_length (&ip, iend, &len))
+			return 0;
+		len += LZ_MIN_MATCH;
+		if (len > (size_t) (oend - op))
+			return 0;
+
+		/* Byte by byte: the match may overlap what it produces. */
+		for (match = op - offset; len > 0; len--)
+			*op++ = *match++;
+	}
+	return op - dst;
+}
@@ -0,0 +1,186 @@
+/* User-space memory allocator.
+
+   Small requests are rounded up to one of a fixed set of size
+   classes.  Each class keeps a list of free blocks of its size, in
+   the manner of a per-thread cache: a block freed by the program
+   goes onto the list of its class and is handed out again by the
+   next request of that class, without any searching or merging.
+   When a list is empty, a run of pages is taken from the heap with
+   sbrk() and carved into blocks of the class.  User processes have a
+   single thread, so the lists need no locking.
+
+   Requests larger than the biggest class get pages of their own
+   from an anonymous mmap(), which free() gives back with munmap().
+
+   Every block starts with a header that records its size, which is
+   how free() and realloc() know where the block belongs. */
+
+#include <malloc.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+
+#define PAGE_SIZE 4096
+
+/* Block header.  Its size keeps the memory after it 16-byte
+   aligned. */
+struct header {
+	size_t size;                /* Usable bytes in the block. */
+	size_t mapped;              /* Bytes mmapped for a large block, or 0. */
+};
+
+/* A free block of a size class, linked through its memory. */
+struct free_block {
+	struct free_block *next;
+};
+
+/* Usable sizes of the size classes.  Classes grow by about a quarter
+   so no more than a fifth of a block is wasted on rounding. */
+static const size_t class_sizes[] = {
+	16, 32, 48, 64, 80, 96, 112, 128,
+	160, 192, 224, 256, 320, 384, 448, 512,
+	640, 768, 896, 1024, 1280, 1536, 1792, 2048,
+};
+#define CLASS_CNT (sizeof class_sizes / sizeof *class_sizes)
+#define MAX_SMALL 2048
+
+/* Free blocks of each class. */
+static struct free_block *free_lists[CLASS_CNT];
+
+/* Blocks carved from the heap per refill of a class, at least. */
+#define REFILL_BLOCKS 8
+
+/* Returns the smallest class that holds SIZE bytes. */
+static size_t
+size_class (size_t size) {
+	size_t c;
+
+	for (c = 0; class_sizes[c] < size; c++)
+		continue;
+	return c;
+}
+
+/* Takes a run of pages from the heap, carves it into blocks of class
+   C and puts them on the class's free list.  Returns false if the
+   heap cannot grow. */
+static bool
+refill (size_t c) {
+	size_t stride = sizeof (struct header) + class_sizes[c];
+	size_t run = ROUND_UP (stride * REFILL_BLOCKS, PAGE_SIZE);
+	uint8_t *p = sbrk (run);
+	size_t i;
+
+	if (p == (void *) -1)
+		return false;
+
+	/* The break is page-aligned unless the program moved it itself. */
+	for (i = -(uintptr_t) p % sizeof (struct header); i + stride <= run;
+			i += stride) {
+		struct header *h = (struct header *) (p + i);
+		struct free_block *b = (struct free_block *) (h + 1);
+
+		h->size = class_sizes[c];
+		h->mapped = 0;
+		b->next = free_lists[c];
+		free_lists[c] = b;
+	}
+	return true;
+}
+
+/* Obtains and returns a new block of at least SIZE bytes.
+   Returns a null pointer if memory is not available. */
+void *
+malloc (size_t size) {
+	struct header *h;
+	size_t mapped;
+
+	if (size <= MAX_SMALL) {
+		size_t c = size_class (size);
+		struct free_block *b;
+
+		if (free_lists[c] == NULL && !refill (c))
+			return NULL;
+		b = free_lists[c];
+		free_lists[c] = b->next;
+		return b;
+	}
+
+	if (size > SIZE_MAX - PAGE_SIZE - sizeof *h)
+		return NULL;
+	mapped = ROUND_UP (sizeof *h + size, PAGE_SIZE);
+	h = mmap (NULL, mapped, true, MAP_ANONYMOUS, 0);
+	if (h == MAP_FAILED)
+		return NULL;
+	h->size = mapped - sizeof *h;
+	h->mapped = mapped;
+	return h + 1;
+}
+
+/* Allocates and returns A times B bytes initialized to zeros.
+   Returns a null pointer if memory is not available. */
+void *
+calloc (size_t a, size_t b) {
+	void *p;
+
+	if (b != 0 && a > SIZE_MAX / b)
+		return NULL;
+	p = malloc (a * b);
+	if (p != NULL)
+		memset (p, 0, a * b);
+	return p;
+}
+
+/* Returns the header of block P. */
+static struct header *
+block_header (void *p) {
+	return (struct header *) p - 1;
+}
+
+/* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly moving it
+   in the process.  If successful, returns the new block; on failure,
+   returns a null pointer.  A call with null OLD_BLOCK is equivalent
+   to malloc(NEW_SIZE).  A call with zero NEW_SIZE is equivalent to
+   free(OLD_BLOCK). */
+void *
+realloc (void *old_block, size_t new_size) {
+	void *new_block;
+	size_t old_size;
+
+	if (new_size == 0) {
+		free (old_block);
+		return NULL;
+	}
+	if (old_block == NULL)
+		return malloc (new_size);
+
+	old_size = block_header (old_block)->size;
+	if (new_size <= old_size)
+		return old_block;
+	new_block = malloc (new_size);
+	if (new_block != NULL) {
+		memcpy (new_block, old_block, old_size);
+		free (old_block);
+	}
+	return new_block;
+}
+
+/* Frees block P, which must have been previously allocated with
+   malloc(), calloc(), or realloc(). */
+void
+free (void *p) {
+	struct header *h;
+	struct free_block *b = p;
+	size_t c;
+
+	if (p == NULL)
+		return;
+	h = block_header (p);
+	if (h->mapped != 0) {
+		munmap (h);
+		return;
+	}
+	c = size_class (h->size);
+	b->next = free_lists[c];
+	free_lists[c] = b;
+}
@@ -0,0 +1,62 @@
+/* Creates 200 files in a directory, enough for it to be hashed and
+   for its leaves to split many times.  Then opens each file, removes
+   every other one, checks that the removed files are gone and that
+   the others cannot be created again, and creates the removed ones
+   again. */
+
+#include <syscall.h>
+#include <stdio.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 200
+
+static const char *
+file_name (size_t i) 
+{
+  static char name[32];
+  snprintf (name, sizeof name, "/x/file%zu", i);
+  return name;
+}
+
+void
+test_main (void) 
+{
+  size_t i;
+  int fd;
+
+  CHECK (mkdir ("/x"), "mkdir \"/x\"");
+
+  msg ("create %d files in \"/x\"", FILE_CNT);
+  for (i = 0; i < FILE_CNT; i++)
+    if (!create (file_name (i), 0))
+      fail ("create \"%s\" failed", file_name (i));
+
+  msg ("open each file");
+  for (i = 0; i < FILE_CNT; i++) 
+    {
+      if ((fd = open (file_name (i))) < 2)
+        fail ("open \"%s\" failed", file_name (i));
+      close (fd);
+    }
+
+  msg ("remove every other file");
+  for (i = 0; i < FILE_CNT; i += 2)
+    if (!remove (file_name (i)))
+      fail ("remove \"%s\" failed", file_name (i));
+
+  msg ("check that removed files are gone");
+  for (i = 0; i < FILE_CNT; i += 2)
+    if (open (file_name (i)) != -1)
+      fail ("open \"%s\" succeeded after removal", file_name (i));
+
+  msg ("check that remaining files cannot be created again");
+  for (i = 1; i < FILE_CNT; i += 2)
+    if (create (file_name (i), 0))
+      fail ("create \"%s\" succeeded but it exists", file_name (i));
+
+  msg ("create the removed files again");
+  for (i = 0; i < FILE_CNT; i += 2)
+    if (!create (file_name (i), 0))
+      fail ("create \"%s\" failed", file_name (i));
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-dir-hash) begin
+(grow-dir-hash) mkdir "/x"
+(grow-dir-hash) create 200 files in "/x"
+(grow-dir-hash) open each file
+(grow-dir-hash) remove every other file
+(grow-dir-hash) check that removed files are gone
+(grow-dir-hash) check that remaining files cannot be created again
+(grow-dir-hash) create the removed files again
+(grow-dir-hash) end
+EOF
+pass;
@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+my ($fs);
+$fs->{$_} = [random_bytes (180224)] foreach 'a', 'b';
+check_archive ($fs);
+pass;
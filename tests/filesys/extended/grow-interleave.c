@@ -0,0 +1,47 @@
+/* Grows two files in turn, 4 kB at a time, and checks that their
+   contents are correct.  Growing them together leaves each file's
+   data in many short runs of sectors instead of a few long ones. */
+
+#include <random.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 2
+#define FILE_SIZE 180224
+#define BLOCK_SIZE 4096
+static char buf[FILE_CNT][FILE_SIZE];
+
+void
+test_main (void) 
+{
+  char file_name[FILE_CNT][8];
+  int fd[FILE_CNT];
+  size_t ofs;
+  int i;
+
+  random_init (0);
+  for (i = 0; i < FILE_CNT; i++) 
+    {
+      random_bytes (buf[i], FILE_SIZE);
+      snprintf (file_name[i], sizeof file_name[i], "%c", 'a' + i);
+      CHECK (create (file_name[i], 0), "create \"%s\"", file_name[i]);
+      CHECK ((fd[i] = open (file_name[i])) > 1, "open \"%s\"", file_name[i]);
+    }
+
+  msg ("write the files %d bytes at a time in turn", BLOCK_SIZE);
+  for (ofs = 0; ofs < FILE_SIZE; ofs += BLOCK_SIZE)
+    for (i = 0; i < FILE_CNT; i++)
+      if (write (fd[i], buf[i] + ofs, BLOCK_SIZE) != BLOCK_SIZE)
+        fail ("write %d bytes at offset %zu in \"%s\" failed",
+              BLOCK_SIZE, ofs, file_name[i]);
+
+  for (i = 0; i < FILE_CNT; i++) 
+    {
+      msg ("close \"%s\"", file_name[i]);
+      close (fd[i]);
+    }
+  for (i = 0; i < FILE_CNT; i++)
+    check_file (file_name[i], buf[i], FILE_SIZE);
+}
@@ -0,0 +1,59 @@
+/* Grows a file, then reads it back in pieces of random size at
+   random offsets and checks each piece.  Every other piece starts
+   on a sector boundary, so that many cover whole sectors, and the
+   last read runs past the end of the file. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 34567
+#define READ_CNT 200
+static char buf[FILE_SIZE];
+static char block[4 * 512 + 511];
+
+void
+test_main (void) 
+{
+  const char *file_name = "testfile";
+  size_t i;
+  int fd;
+
+  random_init (0);
+  random_bytes (buf, sizeof buf);
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (write (fd, buf, sizeof buf) == (int) sizeof buf,
+         "write \"%s\"", file_name);
+
+  msg ("read \"%s\" at random offsets", file_name);
+  for (i = 0; i < READ_CNT; i++) 
+    {
+      size_t ofs = random_ulong () % FILE_SIZE;
+      size_t size = random_ulong () % sizeof block + 1;
+      int ret_val;
+
+      if (i % 2 == 0)
+        ofs -= ofs % 512;
+      if (size > FILE_SIZE - ofs)
+        size = FILE_SIZE - ofs;
+
+      seek (fd, ofs);
+      ret_val = read (fd, block, size);
+      if (ret_val != (int) size)
+        fail ("read %zu bytes at offset %zu in \"%s\" returned %d",
+              size, ofs, file_name, ret_val);
+      compare_bytes (block, buf + ofs, size, ofs, file_name);
+    }
+
+  seek (fd, FILE_SIZE - 100);
+  CHECK (read (fd, block, sizeof block) == 100,
+         "read past end of \"%s\"", file_name);
+  compare_bytes (block, buf + FILE_SIZE - 100, 100, FILE_SIZE - 100,
+                 file_name);
+
+  msg ("close \"%s\"", file_name);
+  close (fd);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-read-mixed) begin
+(grow-read-mixed) create "testfile"
+(grow-read-mixed) open "testfile"
+(grow-read-mixed) write "testfile"
+(grow-read-mixed) read "testfile" at random offsets
+(grow-read-mixed) read past end of "testfile"
+(grow-read-mixed) close "testfile"
+(grow-read-mixed) end
+EOF
+pass;
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+random_bytes (10240);
+my ($b) = random_bytes (10240);
+my ($c) = random_bytes (10240);
+check_archive ({"b" => [$b], "c" => [$c]});
+pass;
@@ -0,0 +1,56 @@
+/* Writes two files, fills the rest of the disk, removes the first
+   file, and writes another file of the same size, which can only get
+   the space the removal freed.  Checks that the second file is intact
+   and that the new one is correct. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 10240
+static char buf_a[FILE_SIZE];
+static char buf_b[FILE_SIZE];
+static char buf_c[FILE_SIZE];
+static char zeros[4096];
+
+static void
+write_file (const char *file_name, const char *buf, size_t size) 
+{
+  int fd;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (write (fd, buf, size) == (int) size, "write \"%s\"", file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+}
+
+void
+test_main (void) 
+{
+  int fd;
+
+  random_init (0);
+  random_bytes (buf_a, sizeof buf_a);
+  random_bytes (buf_b, sizeof buf_b);
+  random_bytes (buf_c, sizeof buf_c);
+
+  write_file ("a", buf_a, sizeof buf_a);
+  write_file ("b", buf_b, sizeof buf_b);
+
+  CHECK (create ("fill", 0), "create \"fill\"");
+  CHECK ((fd = open ("fill")) > 1, "open \"fill\"");
+  msg ("fill the disk");
+  while (write (fd, zeros, sizeof zeros) == (int) sizeof zeros)
+    continue;
+  msg ("close \"fill\"");
+  close (fd);
+
+  CHECK (remove ("a"), "remove \"a\"");
+  write_file ("c", buf_c, sizeof buf_c);
+
+  check_file ("b", buf_b, sizeof buf_b);
+  check_file ("c", buf_c, sizeof buf_c);
+  CHECK (remove ("fill"), "remove \"fill\"");
+}
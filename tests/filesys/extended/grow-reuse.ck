@@ -0,0 +1,34 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-reuse) begin
+(grow-reuse) create "a"
+(grow-reuse) open "a"
+(grow-reuse) write "a"
+(grow-reuse) close "a"
+(grow-reuse) create "b"
+(grow-reuse) open "b"
+(grow-reuse) write "b"
+(grow-reuse) close "b"
+(grow-reuse) create "fill"
+(grow-reuse) open "fill"
+(grow-reuse) fill the disk
+(grow-reuse) close "fill"
+(grow-reuse) remove "a"
+(grow-reuse) create "c"
+(grow-reuse) open "c"
+(grow-reuse) write "c"
+(grow-reuse) close "c"
+(grow-reuse) open "b" for verification
+(grow-reuse) verified contents of "b"
+(grow-reuse) close "b"
+(grow-reuse) open "c" for verification
+(grow-reuse) verified contents of "c"
+(grow-reuse) close "c"
+(grow-reuse) remove "fill"
+(grow-reuse) end
+EOF
+pass;
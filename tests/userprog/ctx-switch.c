@@ -0,0 +1,62 @@
+/* Context-switch microbenchmark.  Times sweeps over a working set
+   of pages, first with the process running alone and then with a
+   forked child sweeping its own copy at the same time, so that the
+   timer keeps switching between two user address spaces.  The
+   difference in cycles per round is what the switches cost,
+   including any TLB refills after them.  The kernel's "TLB:"
+   statistics line shows how many of the switches kept the TLB. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 64
+#define ROUNDS 100000
+
+static char buf[PAGE_CNT * PAGE_SIZE];
+
+static inline uint64_t
+rdtsc (void)
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+/* Sweeps the working set ROUNDS times and returns the average
+   cycles per round. */
+static uint64_t
+sweep (void)
+{
+  uint64_t start = rdtsc ();
+  int round, i;
+
+  for (round = 0; round < ROUNDS; round++)
+    for (i = 0; i < PAGE_CNT; i++)
+      buf[i * PAGE_SIZE]++;
+  return (rdtsc () - start) / ROUNDS;
+}
+
+void
+test_main (void)
+{
+  uint64_t alone, shared;
+  pid_t child;
+
+  alone = sweep ();
+  msg ("alone: %llu cycles per round", alone);
+
+  child = fork ("child");
+  if (child == 0)
+    {
+      sweep ();
+      exit (buf[0] == (char) (2 * ROUNDS) ? 0 : 1);
+    }
+  CHECK (child > 0, "fork");
+  shared = sweep ();
+  msg ("shared with a child: %llu cycles per round", shared);
+  CHECK (buf[0] == (char) (2 * ROUNDS), "parent working set intact");
+  CHECK (wait (child) == 0, "child working set intact");
+}
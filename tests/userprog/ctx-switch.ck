@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+s/: \d+ cycles per round/: N cycles per round/ foreach @output;
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(ctx-switch) begin
+(ctx-switch) alone: N cycles per round
+(ctx-switch) fork
+(ctx-switch) shared with a child: N cycles per round
+(ctx-switch) parent working set intact
+(ctx-switch) child working set intact
+(ctx-switch) end
+EOF
+pass;
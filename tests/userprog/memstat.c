@@ -0,0 +1,36 @@
+/* Queries the memstat system call for the running process and
+   for a process that does not exist.  The BSS array is touched
+   so that the process has more than a handful of resident
+   pages, and the counters must be self-consistent. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 16
+
+static char buf[PAGE_CNT * PAGE_SIZE];
+
+void
+test_main (void)
+{
+  struct memstat ms;
+  int i;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    buf[i * PAGE_SIZE] = i;
+
+  CHECK (memstat (0, &ms) == 0, "memstat self");
+  if (ms.resident < PAGE_CNT)
+    fail ("only %zu pages resident, expected at least %d",
+          ms.resident, PAGE_CNT);
+  if (ms.resident_peak < ms.resident)
+    fail ("peak %zu below current %zu", ms.resident_peak, ms.resident);
+  if (ms.page_tables == 0)
+    fail ("no page table pages charged");
+  if (ms.kernel == 0)
+    fail ("no kernel memory charged");
+
+  CHECK (memstat (-5, &ms) == -1, "memstat on missing pid");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(memstat) begin
+(memstat) memstat self
+(memstat) memstat on missing pid
+(memstat) end
+memstat: exit(0)
+EOF
+pass;
@@ -0,0 +1,70 @@
+/* Launch microbenchmark.  Starts the same child program CHILDREN
+   times with fork, exec and wait, then CHILDREN times with spawn
+   and wait, and reports the average cycles each launch took.
+   spawn loads the child into a fresh address space instead of
+   duplicating the parent's only to throw it away. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILDREN 5
+
+static inline uint64_t
+rdtsc (void)
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+static uint64_t
+fork_exec (void)
+{
+  uint64_t start = rdtsc ();
+  int i;
+
+  for (i = 0; i < CHILDREN; i++)
+    {
+      pid_t pid = fork ("child-simple");
+      if (pid == 0)
+        {
+          exec ("child-simple");
+          exit (-1);
+        }
+      if (pid < 0)
+        fail ("fork returned %d", pid);
+      if (wait (pid) != 81)
+        fail ("forked child did not exit with 81");
+    }
+  return (rdtsc () - start) / CHILDREN;
+}
+
+static uint64_t
+spawn_wait (void)
+{
+  uint64_t start = rdtsc ();
+  int i;
+
+  for (i = 0; i < CHILDREN; i++)
+    {
+      pid_t pid = spawn ("child-simple");
+      if (pid < 0)
+        fail ("spawn returned %d", pid);
+      if (wait (pid) != 81)
+        fail ("spawned child did not exit with 81");
+    }
+  return (rdtsc () - start) / CHILDREN;
+}
+
+void
+test_main (void)
+{
+  uint64_t forked = fork_exec ();
+  uint64_t spawned = spawn_wait ();
+
+  msg ("fork+exec+wait: %llu cycles per child", forked);
+  msg ("spawn+wait: %llu cycles per child", spawned);
+  CHECK (spawn ("no-such-file") == -1, "spawn missing program");
+}
@@ -0,0 +1,39 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+s/: \d+ cycles per child/: N cycles per child/ foreach @output;
+compare_output ("run", \@output, [<<'EOF']);
+(spawn-bench) begin
+(child-simple) run
+child-simple: exit(81)
+(child-simple) run
+child-simple: exit(81)
+(child-simple) run
+child-simple: exit(81)
+(child-simple) run
+child-simple: exit(81)
+(child-simple) run
+child-simple: exit(81)
+(child-simple) run
+child-simple: exit(81)
+(child-simple) run
+child-simple: exit(81)
+(child-simple) run
+child-simple: exit(81)
+(child-simple) run
+child-simple: exit(81)
+(child-simple) run
+child-simple: exit(81)
+(spawn-bench) fork+exec+wait: N cycles per child
+(spawn-bench) spawn+wait: N cycles per child
+load: no-such-file: open failed
+no-such-file: exit(-1)
+(spawn-bench) spawn missing program
+(spawn-bench) end
+spawn-bench: exit(0)
+EOF
+pass;
@@ -0,0 +1,43 @@
+/* Touches the pages of a BSS buffer and checks that the faults
+   were counted as zero-fill faults, both for this process and in
+   the kernel-wide totals, and that unknown processes are refused. */
+
+#include <string.h>
+#include <syscall.h>
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 8
+
+static char buf[PAGE_CNT * PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+static struct faultstat before, after, all;
+
+void
+test_main (void)
+{
+	uint32_t sum;
+	size_t i;
+	int b;
+
+	CHECK (faultstat (0, &before) == 0, "faultstat before");
+	for (i = 0; i < PAGE_CNT; i++)
+		buf[i * PAGE_SIZE] = 1;
+	CHECK (faultstat (0, &after) == 0, "faultstat after");
+
+	if (after.count[FAULT_ZERO] - before.count[FAULT_ZERO] < PAGE_CNT)
+		fail ("only %llu zero-fill faults for %d pages",
+				after.count[FAULT_ZERO] - before.count[FAULT_ZERO], PAGE_CNT);
+	sum = 0;
+	for (b = 0; b < FAULT_HIST_BUCKETS; b++)
+		sum += after.hist[FAULT_ZERO][b];
+	if (sum != after.count[FAULT_ZERO])
+		fail ("histogram holds %u of %llu faults", sum,
+				after.count[FAULT_ZERO]);
+
+	CHECK (faultstat (FAULTSTAT_ALL, &all) == 0, "faultstat all");
+	if (all.count[FAULT_ZERO] < after.count[FAULT_ZERO])
+		fail ("totals smaller than this process's counts");
+	CHECK (faultstat (-5, &all) == -1, "faultstat bad pid");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(faultstat) begin
+(faultstat) faultstat before
+(faultstat) faultstat after
+(faultstat) faultstat all
+(faultstat) faultstat bad pid
+(faultstat) end
+faultstat: exit(0)
+EOF
+pass;
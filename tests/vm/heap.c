@@ -0,0 +1,98 @@
+/* Grows and shrinks the heap with sbrk, maps anonymous memory
+   with mmap, and drives malloc through growth, reuse of freed
+   blocks, realloc and large allocations. */
+
+#include <malloc.h>
+#include <string.h>
+#include <syscall.h>
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define BLOCK_CNT 512
+#define LARGE (100 * 1024)
+
+static char *blocks[BLOCK_CNT];
+
+static size_t
+block_size (int i)
+{
+  return (size_t) i * 37 % 2048 + 1;
+}
+
+static void
+check_block (int i)
+{
+  size_t j;
+
+  for (j = 0; j < block_size (i); j++)
+    if (blocks[i][j] != (char) i)
+      fail ("block %d corrupted at byte %zu", i, j);
+}
+
+void
+test_main (void)
+{
+  char *brk, *p, *q;
+  size_t i;
+  int b;
+
+  brk = sbrk (0);
+  CHECK (sbrk (PAGE_SIZE) == brk, "sbrk grows heap");
+  memset (brk, 'h', PAGE_SIZE);
+  CHECK (sbrk (-PAGE_SIZE) == brk + PAGE_SIZE, "sbrk shrinks heap");
+  CHECK (sbrk (0) == brk, "break restored");
+
+  p = mmap (NULL, 3 * PAGE_SIZE, true, MAP_ANONYMOUS, 0);
+  CHECK (p != MAP_FAILED, "mmap anonymous");
+  for (i = 0; i < 3 * PAGE_SIZE; i++)
+    if (p[i] != 0)
+      fail ("anonymous byte %zu is %d", i, p[i]);
+  memset (p, 'm', 3 * PAGE_SIZE);
+  munmap (p);
+
+  for (b = 0; b < BLOCK_CNT; b++)
+    {
+      blocks[b] = malloc (block_size (b));
+      if (blocks[b] == NULL)
+        fail ("malloc %d failed", b);
+      memset (blocks[b], b, block_size (b));
+    }
+  for (b = 0; b < BLOCK_CNT; b++)
+    check_block (b);
+  msg ("%d blocks allocated", BLOCK_CNT);
+
+  for (b = 0; b < BLOCK_CNT; b += 2)
+    free (blocks[b]);
+  brk = sbrk (0);
+  for (b = 0; b < BLOCK_CNT; b += 2)
+    {
+      blocks[b] = malloc (block_size (b));
+      memset (blocks[b], b, block_size (b));
+    }
+  CHECK (sbrk (0) == brk, "freed blocks reused");
+  for (b = 0; b < BLOCK_CNT; b++)
+    check_block (b);
+
+  p = malloc (100);
+  memset (p, 'r', 100);
+  p = realloc (p, 3000);
+  for (i = 0; i < 100; i++)
+    if (p[i] != 'r')
+      fail ("realloc lost byte %zu", i);
+  free (p);
+
+  p = malloc (LARGE);
+  CHECK (p != NULL, "large malloc");
+  memset (p, 'L', LARGE);
+  free (p);
+  q = calloc (LARGE, 1);
+  for (i = 0; i < LARGE; i++)
+    if (q[i] != 0)
+      fail ("calloc byte %zu is %d", i, q[i]);
+  free (q);
+
+  for (b = 0; b < BLOCK_CNT; b++)
+    free (blocks[b]);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(heap) begin
+(heap) sbrk grows heap
+(heap) sbrk shrinks heap
+(heap) break restored
+(heap) mmap anonymous
+(heap) 512 blocks allocated
+(heap) freed blocks reused
+(heap) large malloc
+(heap) end
+heap: exit(0)
+EOF
+pass;
@@ -0,0 +1,45 @@
+/* Gives advice about a BSS buffer.  MADV_DONTNEED must drop the
+   buffer's pages, which then read back as zeros, and bad ranges
+   must be refused. */
+
+#include <string.h>
+#include <syscall.h>
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 8
+
+static char buf[PAGE_CNT * PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+
+void
+test_main (void)
+{
+	struct memstat before, after;
+	size_t i;
+
+	for (i = 0; i < PAGE_CNT; i++)
+		memset (buf + i * PAGE_SIZE, i + 1, PAGE_SIZE);
+
+	CHECK (madvise (buf, sizeof buf, MADV_SEQUENTIAL) == 0, "madvise sequential");
+	CHECK (madvise (buf, sizeof buf, MADV_WILLNEED) == 0, "madvise willneed");
+	for (i = 0; i < PAGE_CNT; i++)
+		if (buf[i * PAGE_SIZE] != (char) (i + 1))
+			fail ("page %zu lost its contents", i);
+
+	CHECK (memstat (0, &before) == 0, "memstat before");
+	CHECK (madvise (buf, sizeof buf, MADV_DONTNEED) == 0, "madvise dontneed");
+	CHECK (memstat (0, &after) == 0, "memstat after");
+	if (before.resident - after.resident < PAGE_CNT)
+		fail ("only %zu pages dropped", before.resident - after.resident);
+	for (i = 0; i < sizeof buf; i++)
+		if (buf[i] != 0)
+			fail ("byte %zu is %d after dontneed", i, buf[i]);
+
+	CHECK (madvise (buf + 1, PAGE_SIZE, MADV_NORMAL) == -1,
+			"madvise misaligned");
+	CHECK (madvise ((void *) 0x10000000, PAGE_SIZE, MADV_NORMAL) == -1,
+			"madvise unmapped");
+	CHECK (madvise (buf, PAGE_SIZE, 42) == -1, "madvise bad advice");
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(madvise) begin
+(madvise) madvise sequential
+(madvise) madvise willneed
+(madvise) memstat before
+(madvise) madvise dontneed
+(madvise) memstat after
+(madvise) madvise misaligned
+(madvise) madvise unmapped
+(madvise) madvise bad advice
+(madvise) end
+madvise: exit(0)
+EOF
+pass;
@@ -0,0 +1,31 @@
+/* Calls msync on a range that maps no file, which must succeed and
+   leave the memory alone, and on bad ranges, which must fail.
+
+   Writing dirty file pages back is not covered here: there is no
+   open system call yet, and mmap only accepts MAP_ANONYMOUS, so a
+   user program cannot map a file. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 4
+
+static char buf[PAGE_CNT * PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+
+void
+test_main (void)
+{
+	size_t i;
+
+	memset (buf, 'x', sizeof buf);
+	CHECK (msync (buf, sizeof buf) == 0, "msync anonymous");
+	for (i = 0; i < sizeof buf; i++)
+		if (buf[i] != 'x')
+			fail ("byte %zu changed to %d", i, buf[i]);
+
+	CHECK (msync (buf + 1, PAGE_SIZE) == -1, "msync misaligned");
+	CHECK (msync ((void *) 0x10000000, PAGE_SIZE) == -1, "msync unmapped");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(msync) begin
+(msync) msync anonymous
+(msync) msync misaligned
+(msync) msync unmapped
+(msync) end
+msync: exit(0)
+EOF
+pass;
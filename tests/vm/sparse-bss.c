@@ -0,0 +1,37 @@
+/* Touches a handful of pages spread across a very large BSS.
+   The segment must cost nothing until it is faulted in, so only
+   the touched pages may become resident. */
+
+#include <string.h>
+#include <syscall.h>
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define BSS_SIZE (256 * 1024 * 1024)
+#define TOUCH_COUNT 16
+#define STRIDE (BSS_SIZE / TOUCH_COUNT)
+
+static char bss[BSS_SIZE];
+
+void
+test_main (void)
+{
+	struct memstat before, after;
+	size_t i;
+
+	CHECK (memstat (0, &before) == 0, "memstat before");
+	for (i = 0; i < TOUCH_COUNT; i++)
+		bss[i * STRIDE] = (char) i + 1;
+	for (i = 0; i < TOUCH_COUNT; i++)
+		if (bss[i * STRIDE] != (char) i + 1 || bss[i * STRIDE + 1] != 0)
+			fail ("bad content at page %zu", i * STRIDE / PAGE_SIZE);
+	CHECK (memstat (0, &after) == 0, "memstat after");
+
+	if (after.resident - before.resident < TOUCH_COUNT)
+		fail ("only %zu new pages resident", after.resident - before.resident);
+	if (after.resident - before.resident > TOUCH_COUNT + 8)
+		fail ("%zu pages resident after touching %d",
+				after.resident - before.resident, TOUCH_COUNT);
+}
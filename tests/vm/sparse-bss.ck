@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sparse-bss) begin
+(sparse-bss) memstat before
+(sparse-bss) memstat after
+(sparse-bss) end
+EOF
+pass;
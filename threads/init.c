@@ -24,16 +24,23 @@
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
+#include "userprog/faultstat.h"
 #include "userprog/gdt.h"
+#include "userprog/memstat.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
 #endif
 #include "tests/threads/tests.h"
 #ifdef VM
+#include "vm/flushd.h"
+#include "vm/ksm.h"
+#include "vm/kswapd.h"
 #include "vm/vm.h"
+#include "vm/zswap.h"
 #endif
 #ifdef FILESYS
 #include "devices/disk.h"
+#include "filesys/buffer_cache.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
@@ -165,6 +172,7 @@ paging_init (uint64_t mem_end) {
 
 	// reload cr3
 	pml4_activate(0);
+	pcid_init ();
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -226,6 +234,20 @@ parse_options (char **argv) {
 			user_page_limit = atoi (value);
 		else if (!strcmp (name, "-threads-tests"))
 			thread_tests = true;
+#endif
+#ifdef VM
+		else if (!strcmp (name, "-zswap"))
+			zswap_pool_pages = atoi (value);
+		else if (!strcmp (name, "-fa"))
+			fault_around_pages = atoi (value);
+		else if (!strcmp (name, "-prefault"))
+			exec_prefault_pages = atoi (value);
+		else if (!strcmp (name, "-ksm"))
+			ksm_scan_pages = atoi (value);
+		else if (!strcmp (name, "-kswapd"))
+			kswapd_low_pages = atoi (value);
+		else if (!strcmp (name, "-flushd"))
+			flushd_ticks = atoi (value);
 #endif
 		else
 			PANIC ("unknown option `%s' (use -h for help)", name);
@@ -328,6 +350,18 @@ usage (void) {
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+			"  -zswap=PAGES       Compress swapped pages into PAGES pages of RAM.\n"
+			"  -fa=PAGES          Map up to PAGES file pages per page fault.\n"
+			"  -prefault=PAGES    Read in programs of up to PAGES pages whole\n"
+			"                     at exec.\n"
+			"  -ksm=PAGES         Merge identical pages, scanning PAGES frames\n"
+			"                     every 100 ms.\n"
+			"  -kswapd=PAGES      Reclaim in the background below PAGES free\n"
+			"                     user pages; 0 disables.\n"
+			"  -flushd=TICKS      Write back mapped files every TICKS timer\n"
+			"                     ticks; 0 disables.\n"
 #endif
 			);
 	power_off ();
@@ -356,10 +390,18 @@ print_stats (void) {
 	thread_print_stats ();
 #ifdef FILESYS
 	disk_print_stats ();
+	buffer_cache_print_stats ();
 #endif
 	console_print_stats ();
 	kbd_print_stats ();
+	palloc_print_stats ();
 #ifdef USERPROG
 	exception_print_stats ();
+	pml4_print_stats ();
+	memstat_print_stats ();
+	faultstat_print_stats ();
+#endif
+#ifdef VM
+	vm_print_stats ();
 #endif
 }
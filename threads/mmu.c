@@ -6,19 +6,69 @@
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
+#include "threads/interrupt.h"
+#include <stdio.h>
 #include "intrinsic.h"
+#ifdef USERPROG
+#include "userprog/memstat.h"
+#endif
+
+/* Charges N page table pages of a user pml4 to the running process,
+ * which is the one building or tearing down its own address space. */
+#ifdef USERPROG
+#define charge_page_tables(N) \
+	memstat_charge (thread_current (), MEMSTAT_PAGE_TABLES, (N))
+#else
+#define charge_page_tables(N) ((void) 0)
+#endif
+
+/* Process-context identifiers (PCIDs).
+ *
+ * With CR4.PCIDE set, the low 12 bits of CR3 tag every TLB entry with
+ * the PCID of the address space that created it, and a CR3 load with
+ * bit 63 set keeps the entries of all PCIDs instead of flushing the
+ * whole TLB.  PCID 0 is permanently owned by base_pml4.  The remaining
+ * address spaces share PCID_SLOTS dynamic PCIDs, handed out round-robin
+ * the first time a pml4 is activated.  A slot whose PCID may still hold
+ * translations of another (or outdated) address space is "stale" and
+ * its next load is done without the no-flush bit, which drops exactly
+ * that PCID's entries. */
+#define CR4_PCIDE (1UL << 17)          /* CR4: enable PCIDs. */
+#define CPUID_1_ECX_PCID (1U << 17)    /* CPUID.01H:ECX: PCIDs supported. */
+#define CR3_NOFLUSH (1UL << 63)        /* CR3: keep TLB entries of the PCID. */
+#define PCID_SLOTS 16
+
+struct pcid_slot {
+	uint64_t *pml4;                 /* Owner, or NULL if free. */
+	bool stale;                     /* Must flush on next activation. */
+};
+
+static bool pcid_enabled;
+static struct pcid_slot pcid_slots[PCID_SLOTS];
+static unsigned pcid_victim;            /* Next slot to recycle. */
+static uint64_t *active_pml4;           /* pml4 currently loaded in CR3. */
+
+/* Statistics. */
+static long long cr3_load_cnt;          /* # of CR3 loads. */
+static long long cr3_flush_cnt;         /* # of loads that flushed the TLB. */
+static long long cr3_skip_cnt;          /* # of activations needing no load. */
+
+static void pcid_release (uint64_t *pml4);
+static void tlb_invalidate (uint64_t *pml4, const void *vpage);
 
 static uint64_t *
-pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
+pgdir_walk (uint64_t *pdp, const uint64_t va, int create, bool user) {
 	int idx = PDX (va);
 	if (pdp) {
 		uint64_t *pte = (uint64_t *) pdp[idx];
 		if (!((uint64_t) pte & PTE_P)) {
 			if (create) {
 				uint64_t *new_page = palloc_get_page (PAL_ZERO);
-				if (new_page)
+				if (new_page) {
 					pdp[idx] = vtop (new_page) | PTE_U | PTE_W | PTE_P;
-				else
+					if (user)
+						charge_page_tables (1);
+				} else
 					return NULL;
 			} else
 				return NULL;
@@ -29,7 +79,7 @@ pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 }
 
 static uint64_t *
-pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
+pdpe_walk (uint64_t *pdpe, const uint64_t va, int create, bool user) {
 	uint64_t *pte = NULL;
 	int idx = PDPE (va);
 	int allocated = 0;
@@ -46,12 +96,13 @@ pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
 			} else
 				return NULL;
 		}
-		pte = pgdir_walk (ptov (PTE_ADDR (pdpe[idx])), va, create);
+		pte = pgdir_walk (ptov (PTE_ADDR (pdpe[idx])), va, create, user);
 	}
 	if (pte == NULL && allocated) {
 		palloc_free_page ((void *) ptov (PTE_ADDR (pdpe[idx])));
 		pdpe[idx] = 0;
-	}
+	} else if (allocated && user)
+		charge_page_tables (1);
 	return pte;
 }
 
@@ -66,6 +117,7 @@ pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 	uint64_t *pte = NULL;
 	int idx = PML4 (va);
 	int allocated = 0;
+	bool user = pml4e != base_pml4;
 	if (pml4e) {
 		uint64_t *pdpe = (uint64_t *) pml4e[idx];
 		if (!((uint64_t) pdpe & PTE_P)) {
@@ -79,12 +131,13 @@ pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 			} else
 				return NULL;
 		}
-		pte = pdpe_walk (ptov (PTE_ADDR (pml4e[idx])), va, create);
+		pte = pdpe_walk (ptov (PTE_ADDR (pml4e[idx])), va, create, user);
 	}
 	if (pte == NULL && allocated) {
 		palloc_free_page ((void *) ptov (PTE_ADDR (pml4e[idx])));
 		pml4e[idx] = 0;
-	}
+	} else if (allocated && user)
+		charge_page_tables (1);
 	return pte;
 }
 
@@ -95,8 +148,10 @@ pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 uint64_t *
 pml4_create (void) {
 	uint64_t *pml4 = palloc_get_page (0);
-	if (pml4)
+	if (pml4) {
 		memcpy (pml4, base_pml4, PGSIZE);
+		charge_page_tables (1);
+	}
 	return pml4;
 }
 
@@ -155,7 +210,9 @@ pml4_for_each (uint64_t *pml4, pte_for_each_func *func, void *aux) {
 	return true;
 }
 
-static void
+/* The *_destroy() helpers return the number of page table pages
+ * they freed. */
+static long
 pt_destroy (uint64_t *pt) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pt[i]);
@@ -163,26 +220,31 @@ pt_destroy (uint64_t *pt) {
 			palloc_free_page ((void *) PTE_ADDR (pte));
 	}
 	palloc_free_page ((void *) pt);
+	return 1;
 }
 
-static void
+static long
 pgdir_destroy (uint64_t *pdp) {
+	long cnt = 1;
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
 		if (((uint64_t) pte) & PTE_P)
-			pt_destroy (PTE_ADDR (pte));
+			cnt += pt_destroy (PTE_ADDR (pte));
 	}
 	palloc_free_page ((void *) pdp);
+	return cnt;
 }
 
-static void
+static long
 pdpe_destroy (uint64_t *pdpe) {
+	long cnt = 1;
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pde = ptov((uint64_t *) pdpe[i]);
 		if (((uint64_t) pde) & PTE_P)
-			pgdir_destroy ((void *) PTE_ADDR (pde));
+			cnt += pgdir_destroy ((void *) PTE_ADDR (pde));
 	}
 	palloc_free_page ((void *) pdpe);
+	return cnt;
 }
 
 /* Destroys pml4e, freeing all the pages it references. */
@@ -192,18 +254,137 @@ pml4_destroy (uint64_t *pml4) {
 		return;
 	ASSERT (pml4 != base_pml4);
 
+	/* Never free the tables under the CPU's feet, and make sure the
+	 * next owner of this page does not inherit our PCID's entries. */
+	if (pml4 == active_pml4)
+		pml4_activate (NULL);
+	pcid_release (pml4);
+
 	/* if PML4 (vaddr) >= 1, it's kernel space by define. */
+	long cnt = 1;
 	uint64_t *pdpe = ptov ((uint64_t *) pml4[0]);
 	if (((uint64_t) pdpe) & PTE_P)
-		pdpe_destroy ((void *) PTE_ADDR (pdpe));
+		cnt += pdpe_destroy ((void *) PTE_ADDR (pdpe));
 	palloc_free_page ((void *) pml4);
+	charge_page_tables (-cnt);
+}
+
+/* Turns on PCIDs if the CPU supports them.  Must be called while
+ * base_pml4 is loaded, since CR4.PCIDE may only be set when the
+ * current PCID is 0. */
+void
+pcid_init (void) {
+	uint32_t eax, ebx, ecx, edx;
+
+	cpuid (1, &eax, &ebx, &ecx, &edx);
+	if ((ecx & CPUID_1_ECX_PCID) == 0)
+		return;
+
+	ASSERT ((rcr3 () & PGMASK) == 0);
+	lcr4 (rcr4 () | CR4_PCIDE);
+	pcid_enabled = true;
+}
+
+/* Returns the PCID for PML4, assigning one if it has none.  Sets
+ * *FLUSH to true if the TLB entries tagged with that PCID must be
+ * dropped when it is loaded. */
+static unsigned
+pcid_get (uint64_t *pml4, bool *flush) {
+	struct pcid_slot *slot;
+	unsigned i;
+
+	if (pml4 == base_pml4) {
+		*flush = false;
+		return 0;
+	}
+
+	for (i = 0; i < PCID_SLOTS; i++) {
+		slot = &pcid_slots[i];
+		if (slot->pml4 == pml4) {
+			*flush = slot->stale;
+			slot->stale = false;
+			return i + 1;
+		}
+	}
+
+	/* Recycle a slot.  Its PCID may still tag entries of the previous
+	 * owner, so the first load must flush them. */
+	i = pcid_victim;
+	pcid_victim = (pcid_victim + 1) % PCID_SLOTS;
+	pcid_slots[i].pml4 = pml4;
+	pcid_slots[i].stale = false;
+	*flush = true;
+	return i + 1;
+}
+
+/* Gives up the PCID held by PML4, if any. */
+static void
+pcid_release (uint64_t *pml4) {
+	enum intr_level old_level = intr_disable ();
+	for (unsigned i = 0; i < PCID_SLOTS; i++)
+		if (pcid_slots[i].pml4 == pml4)
+			pcid_slots[i].pml4 = NULL;
+	intr_set_level (old_level);
+}
+
+/* Drops the TLB entry for VPAGE in PML4 after its PTE changed.  The
+ * entries of an address space that is not loaded are tagged with its
+ * PCID and survive switching away from it, so they are flushed the
+ * next time PML4 is activated instead. */
+static void
+tlb_invalidate (uint64_t *pml4, const void *vpage) {
+	enum intr_level old_level = intr_disable ();
+	if (pml4 == active_pml4)
+		invlpg ((uint64_t) vpage);
+	else if (pcid_enabled)
+		for (unsigned i = 0; i < PCID_SLOTS; i++)
+			if (pcid_slots[i].pml4 == pml4)
+				pcid_slots[i].stale = true;
+	intr_set_level (old_level);
 }
 
 /* Loads page directory PD into the CPU's page directory base
- * register. */
+ * register.  Activating the address space that is already loaded is
+ * free, and with PCIDs switching between address spaces keeps the
+ * TLB entries of both. */
 void
 pml4_activate (uint64_t *pml4) {
-	lcr3 (vtop (pml4 ? pml4 : base_pml4));
+	enum intr_level old_level;
+	uint64_t cr3;
+	bool flush = true;
+
+	if (pml4 == NULL)
+		pml4 = base_pml4;
+
+	old_level = intr_disable ();
+	if (pml4 == active_pml4) {
+		cr3_skip_cnt++;
+		intr_set_level (old_level);
+		return;
+	}
+
+	cr3 = vtop (pml4);
+	if (pcid_enabled) {
+		cr3 |= pcid_get (pml4, &flush);
+		if (!flush)
+			cr3 |= CR3_NOFLUSH;
+	}
+	lcr3 (cr3);
+	active_pml4 = pml4;
+
+	cr3_load_cnt++;
+	if (flush)
+		cr3_flush_cnt++;
+	intr_set_level (old_level);
+}
+
+/* Prints address space switch statistics. */
+void
+pml4_print_stats (void) {
+	printf ("TLB: PCIDs %s, %lld CR3 loads (%lld flushing), "
+			"%lld switches skipped\n",
+			pcid_enabled ? "on" : "off",
+			cr3_load_cnt, cr3_flush_cnt, cr3_skip_cnt);
 }
 
 /* Looks up the physical address that corresponds to user virtual
@@ -238,8 +419,12 @@ pml4_set_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
 
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) upage, 1);
 
-	if (pte)
+	if (pte) {
+		bool was_present = (*pte & PTE_P) != 0;
 		*pte = vtop (kpage) | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+		if (was_present)
+			tlb_invalidate (pml4, upage);
+	}
 	return pte != NULL;
 }
 
@@ -257,8 +442,7 @@ pml4_clear_page (uint64_t *pml4, void *upage) {
 
 	if (pte != NULL && (*pte & PTE_P) != 0) {
 		*pte &= ~PTE_P;
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) upage);
+		tlb_invalidate (pml4, upage);
 	}
 }
 
@@ -281,10 +465,9 @@ pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
 		if (dirty)
 			*pte |= PTE_D;
 		else
-			*pte &= ~(uint32_t) PTE_D;
+			*pte &= ~(uint64_t) PTE_D;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		tlb_invalidate (pml4, vpage);
 	}
 }
 
@@ -307,9 +490,23 @@ pml4_set_accessed (uint64_t *pml4, const void *vpage, bool accessed) {
 		if (accessed)
 			*pte |= PTE_A;
 		else
-			*pte &= ~(uint32_t) PTE_A;
+			*pte &= ~(uint64_t) PTE_A;
+
+		tlb_invalidate (pml4, vpage);
+	}
+}
+
+/* Sets the writable bit to WRITABLE in the PTE for virtual page
+ * VPAGE in PML4, keeping the mapping and its other bits. */
+void
+pml4_set_writable (uint64_t *pml4, const void *vpage, bool writable) {
+	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
+	if (pte) {
+		if (writable)
+			*pte |= PTE_W;
+		else
+			*pte &= ~(uint64_t) PTE_W;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		tlb_invalidate (pml4, vpage);
 	}
 }
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -30,6 +31,8 @@
 struct pool {
 	struct lock lock;               /* Mutual exclusion. */
 	struct bitmap *used_map;        /* Bitmap of free pages. */
+	uint16_t *refs;                 /* Extra references to each page. */
+	size_t free_cnt;                /* Number of free pages. */
 	uint8_t *base;                  /* Base of pool. */
 };
 
@@ -42,6 +45,8 @@ static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static void adjust_free_cnt (struct pool *, long delta);
+static struct pool *pool_of (void *page);
 
 /* multiboot info */
 struct multiboot_info {
@@ -224,11 +229,13 @@ split:
 			if ((uint64_t) pool_end < end) {
 				page_cnt = ((uint64_t) pool_end - start) / PGSIZE;
 				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				pool->free_cnt += page_cnt;
 				start = (uint64_t) pool_end;
 				goto split;
 			} else {
 				page_cnt = ((uint64_t) end - start) / PGSIZE;
 				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				pool->free_cnt += page_cnt;
 			}
 		}
 	}
@@ -265,6 +272,8 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 
 	lock_acquire (&pool->lock);
 	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+	if (page_idx != BITMAP_ERROR)
+		adjust_free_cnt (pool, -(long) page_cnt);
 	lock_release (&pool->lock);
 	void *pages;
 
@@ -306,20 +315,28 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 	if (pages == NULL || page_cnt == 0)
 		return;
 
-	if (page_from_pool (&kernel_pool, pages))
-		pool = &kernel_pool;
-	else if (page_from_pool (&user_pool, pages))
-		pool = &user_pool;
-	else
-		NOT_REACHED ();
-
+	pool = pool_of (pages);
 	page_idx = pg_no (pages) - pg_no (pool->base);
 
+	/* A shared page only loses one reference.  Interrupts, not the
+	   pool lock, guard the counts, since the scheduler frees pages
+	   too. */
+	if (page_cnt == 1) {
+		enum intr_level old_level = intr_disable ();
+		bool shared = pool->refs[page_idx] > 0;
+		if (shared)
+			pool->refs[page_idx]--;
+		intr_set_level (old_level);
+		if (shared)
+			return;
+	}
+
 #ifndef NDEBUG
 	memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
 	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	adjust_free_cnt (pool, page_cnt);
 }
 
 /* Frees the page at PAGE. */
@@ -328,23 +345,107 @@ palloc_free_page (void *page) {
 	palloc_free_multiple (page, 1);
 }
 
+/* Adds a reference to PAGE, which must be in use.  PAGE is then
+   freed only once palloc_free_page() has been called for it one
+   more time.  This lets processes share user pages. */
+void
+palloc_share_page (void *page) {
+	struct pool *pool = pool_of (page);
+	size_t page_idx = pg_no (page) - pg_no (pool->base);
+	enum intr_level old_level;
+
+	ASSERT (pg_ofs (page) == 0);
+	ASSERT (bitmap_test (pool->used_map, page_idx));
+
+	old_level = intr_disable ();
+	ASSERT (pool->refs[page_idx] < UINT16_MAX);
+	pool->refs[page_idx]++;
+	intr_set_level (old_level);
+}
+
+/* Returns the number of references to PAGE, which must be in
+   use: one, plus one for each palloc_share_page() not yet
+   matched by a free. */
+size_t
+palloc_page_refcnt (void *page) {
+	struct pool *pool = pool_of (page);
+	size_t page_idx = pg_no (page) - pg_no (pool->base);
+
+	ASSERT (bitmap_test (pool->used_map, page_idx));
+	return pool->refs[page_idx] + 1;
+}
+
+/* Returns the number of free pages in the user pool if PAL_USER
+   is set in FLAGS, otherwise in the kernel pool. */
+size_t
+palloc_free_cnt (enum palloc_flags flags) {
+	return (flags & PAL_USER ? &user_pool : &kernel_pool)->free_cnt;
+}
+
+/* Returns the number of pages in the user pool if PAL_USER is
+   set in FLAGS, otherwise in the kernel pool. */
+size_t
+palloc_pool_size (enum palloc_flags flags) {
+	return bitmap_size ((flags & PAL_USER ? &user_pool : &kernel_pool)->used_map);
+}
+
+/* Prints the number of pages in use in each pool. */
+void
+palloc_print_stats (void) {
+	struct pool *pools[] = { &kernel_pool, &user_pool };
+	const char *names[] = { "kernel", "user" };
+
+	for (int i = 0; i < 2; i++) {
+		struct pool *p = pools[i];
+		lock_acquire (&p->lock);
+		printf ("Palloc: %s pool %zu of %zu pages in use\n", names[i],
+				bitmap_count (p->used_map, 0, bitmap_size (p->used_map), true),
+				bitmap_size (p->used_map));
+		lock_release (&p->lock);
+	}
+}
+
 /* Initializes pool P as starting at START and ending at END */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
-  /* We'll put the pool's used_map at its base.
+  /* We'll put the pool's used_map at its base, followed by
+     the reference counts.
      Calculate the space needed for the bitmap
      and subtract it from the pool's size. */
 	uint64_t pgcnt = (end - start) / PGSIZE;
 	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
+	size_t ref_pages = DIV_ROUND_UP (pgcnt * sizeof *p->refs, PGSIZE) * PGSIZE;
 
 	lock_init(&p->lock);
 	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
+	p->refs = *bm_base + bm_pages;
+	p->free_cnt = 0;
 	p->base = (void *) start;
 
 	// Mark all to unusable.
 	bitmap_set_all(p->used_map, true);
+	memset (p->refs, 0, ref_pages);
+
+	*bm_base += bm_pages + ref_pages;
+}
+
+/* Adds DELTA to POOL's count of free pages.  Interrupts, not the
+   pool lock, guard the count, since the scheduler frees pages. */
+static void
+adjust_free_cnt (struct pool *pool, long delta) {
+	enum intr_level old_level = intr_disable ();
+	pool->free_cnt += delta;
+	intr_set_level (old_level);
+}
 
-	*bm_base += bm_pages;
+/* Returns the pool that PAGE belongs to. */
+static struct pool *
+pool_of (void *page) {
+	if (page_from_pool (&kernel_pool, page))
+		return &kernel_pool;
+	else if (page_from_pool (&user_pool, page))
+		return &user_pool;
+	NOT_REACHED ();
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -13,6 +13,7 @@
 #include "intrinsic.h"
 #include "threads/fixed_point.h" /** project1-Advanced Scheduler */
 #ifdef USERPROG
+#include "userprog/memstat.h"
 #include "userprog/process.h"
 #endif
 
@@ -33,7 +34,8 @@ static int64_t next_tick_to_awake;
    that are ready to run but not actually running. */
 static struct list ready_list;
 
-/** project1-Advanced Scheduler */
+/* List of all live threads.  Walked by the advanced scheduler
+   and by thread_find(). */
 static struct list all_list;
 
 /* Idle thread. */
@@ -127,10 +129,6 @@ thread_init (void) {
 	initial_thread = running_thread ();
 	init_thread (initial_thread, "main", PRI_DEFAULT);
 
-	/** project1-Advanced Scheduler */
-	if (thread_mlfqs)
-		list_push_back(&all_list, &(initial_thread->all_elem));
-
 	initial_thread->status = THREAD_RUNNING;
 	initial_thread->tid = allocate_tid ();
 }
@@ -202,6 +200,9 @@ thread_create (const char *name, int priority,
 		thread_func *function, void *aux) {
 	struct thread *t;
 	tid_t tid;
+#ifdef USERPROG
+	enum intr_level old_level;
+#endif
 
 	ASSERT (function != NULL);
 
@@ -213,6 +214,15 @@ thread_create (const char *name, int priority,
 	/* Initialize thread. */
 	init_thread (t, name, priority);
 	tid = t->tid = allocate_tid ();
+#ifdef USERPROG
+	memstat_charge (t, MEMSTAT_KERNEL, PGSIZE);
+
+	/* 자식이 실행되기 전에 목록에 넣어야 부모가 곧바로 wait할 수 있습니다.
+	 * 커널 스레드인 자식은 종료하며 스스로 빠지므로 인터럽트를 끄고 넣습니다. */
+	old_level = intr_disable ();
+	list_push_back (&thread_current ()->child_list, &t->child_elem);
+	intr_set_level (old_level);
+#endif
 
 	// #define USERPROG
 	// /** project2-System Call */
@@ -318,6 +328,24 @@ thread_tid (void) {
 	return thread_current ()->tid;
 }
 
+/* Returns the live thread whose tid is TID, or a null pointer if
+   there is none.  Interrupts must be off, so that the thread
+   cannot exit while the caller looks at it. */
+struct thread *
+thread_find (tid_t tid) {
+	struct list_elem *e;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	for (e = list_begin (&all_list); e != list_end (&all_list);
+			e = list_next (e)) {
+		struct thread *t = list_entry (e, struct thread, all_elem);
+		if (t->tid == tid && t->status != THREAD_DYING)
+			return t;
+	}
+	return NULL;
+}
+
 /* Deschedules the current thread and destroys it.  Never
    returns to the caller. */
 void
@@ -327,12 +355,10 @@ thread_exit (void) {
 #ifdef USERPROG
 	process_exit ();
 #endif
-	/** project1-Advanced Scheduler */
-	if (thread_mlfqs)
-        list_remove(&thread_current()->all_elem);
 	/* Just set our status to dying and schedule another process.
 	   We will be destroyed during the call to schedule_tail(). */
 	intr_disable ();
+	list_remove (&thread_current ()->all_elem);
 	do_schedule (THREAD_DYING);
 	NOT_REACHED ();
 }
@@ -481,6 +507,8 @@ kernel_thread (thread_func *function, void *aux) {
    NAME. */
 static void
 init_thread (struct thread *t, const char *name, int priority) {
+	enum intr_level old_level;
+
 	ASSERT (t != NULL);
 	ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
 	ASSERT (name != NULL);
@@ -491,12 +519,16 @@ init_thread (struct thread *t, const char *name, int priority) {
 	t->tf.rsp = (uint64_t) t + PGSIZE - sizeof (void *);
 
 	/** project1-Advanced Scheduler */
-    if (thread_mlfqs) {
-        mlfqs_priority(t);
-        list_push_back(&all_list, &t->all_elem);
-    } else {
-        t->priority = priority;
-    }
+	if (thread_mlfqs) {
+		mlfqs_priority(t);
+	} else {
+		t->priority = priority;
+	}
+
+	/* all_list is also walked by the timer interrupt. */
+	old_level = intr_disable ();
+	list_push_back (&all_list, &t->all_elem);
+	intr_set_level (old_level);
 
     t->wait_lock = NULL;
     list_init(&t->donations);
@@ -8,6 +8,9 @@
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "userprog/process.h"
+#include "userprog/faultstat.h"
+#include "userprog/uaccess.h"
 #include "intrinsic.h"
 
 /* 처리된 페이지 오류 수. */
@@ -79,6 +82,7 @@ kill (struct intr_frame *f) {
 			printf ("%s: dying due to interrupt %#04llx (%s).\n",
 					thread_name (), f->vec_no, intr_name (f->vec_no));
 			intr_dump_frame (f);
+			thread_current ()->exit_status = -1;
 			thread_exit ();
 
 		case SEL_KCSEG:
@@ -112,12 +116,17 @@ page_fault (struct intr_frame *f) {
 	bool write;        /* True: access was write, false: access was read. */
 	bool user;         /* True: access by user, false: access by kernel. */
 	void *fault_addr;  /* Fault address. */
+	uint64_t start;    /* TSC at the fault. */
+#ifdef VM
+	enum fault_class class;
+#endif
 
 	/* 오류 발생 주소, 즉 오류를 발생시킨 가상 주소를 구합니다.
 	   이 주소는 코드나 데이터를 가리킬 수 있습니다.
 	   오류를 발생시킨 명령어(즉, f->rip)의 주소일 필요는 없습니다. */
 
 	fault_addr = (void *) rcr2();
+	start = rdtsc ();
 
 	/* 인터럽트를 다시 켜세요(CR2가 변경되기 전에 읽을 수 있도록 하기 위해 인터럽트를 꺼두었습니다). */
 	intr_enable ();
@@ -130,9 +139,23 @@ page_fault (struct intr_frame *f) {
 
 #ifdef VM
 	/* For project 3 and later. */
-	if (vm_try_handle_fault (f, fault_addr, user, write, not_present))
+	if (vm_handle_fault (f, fault_addr, user, write, not_present, &class)) {
+		faultstat_record (class, rdtsc () - start);
+		return;
+	}
+#else
+	/* fork 뒤 부모와 공유 중인 페이지에 처음 쓰는 경우입니다. */
+	if (!not_present && write && process_handle_cow (fault_addr)) {
+		faultstat_record (FAULT_COW, rdtsc () - start);
 		return;
+	}
 #endif
+	faultstat_record (FAULT_INVALID, rdtsc () - start);
+
+	/* 커널이 사용자 메모리를 복사하다 난 폴트라면 복사 루틴의 복구 코드로
+	 * 돌아가 실패를 알리게 합니다. */
+	if (!user && uaccess_fixup (f))
+		return;
 
 	/* 페이지 폴트를 계산합니다. */
 	page_fault_cnt++;
@@ -0,0 +1,123 @@
+/* faultstat.c: 페이지 폴트 종류별 횟수와 처리 시간 집계.
+ *
+ * page_fault()가 폴트 하나를 처리할 때마다 종류와 걸린 TSC 사이클 수를
+ * faultstat_record()로 넘깁니다. 처리 시간은 2의 거듭제곱 단위 구간으로
+ * 나눈 히스토그램에 쌓입니다. 프로세스별 통계는 프로세스를 만들 때
+ * 할당하고 프로세스가 끝날 때 해제하며, 커널 전체 합계는 계속
+ * 유지합니다. 폴트 처리 중에는 메모리를 할당하지 않습니다. 폴트가
+ * malloc()의 락을 쥔 채로 났을 수도 있기 때문입니다. */
+
+#include "userprog/faultstat.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "userprog/memstat.h"
+
+/* 출력할 때 쓰는 종류별 이름. */
+static const char *class_names[FAULT_CLASS_CNT] = {
+	"elf", "zero", "file", "swap", "stack", "cow", "invalid",
+};
+
+/* 모든 프로세스의 합계. */
+static struct faultstat total;
+
+/* CYCLES가 들어갈 히스토그램 구간 번호를 반환합니다. */
+static int
+hist_bucket (uint64_t cycles) {
+	int bucket = 0;
+
+	while (cycles >>= 1)
+		bucket++;
+	return bucket < FAULT_HIST_BUCKETS ? bucket : FAULT_HIST_BUCKETS - 1;
+}
+
+/* FS에 CLASS 종류의 폴트 하나가 CYCLES 사이클 걸렸다고 기록합니다. */
+static void
+add_fault (struct faultstat *fs, enum fault_class class, uint64_t cycles) {
+	fs->count[class]++;
+	fs->cycles[class] += cycles;
+	fs->hist[class][hist_bucket (cycles)]++;
+}
+
+/* 새 프로세스 T의 통계를 할당합니다. 메모리가 없으면 T의 폴트는
+ * 합계에만 더해집니다. */
+void
+faultstat_init (struct thread *t) {
+	ASSERT (t->faults == NULL);
+
+	t->faults = calloc (1, sizeof *t->faults);
+	if (t->faults != NULL)
+		memstat_charge (t, MEMSTAT_KERNEL, sizeof *t->faults);
+}
+
+/* 현재 스레드가 처리한 CLASS 종류의 폴트가 CYCLES 사이클 걸렸다고
+ * 기록합니다. 커널 스레드처럼 프로세스별 통계가 없으면 합계에만
+ * 더합니다. */
+void
+faultstat_record (enum fault_class class, uint64_t cycles) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+
+	ASSERT (class < FAULT_CLASS_CNT);
+
+	old_level = intr_disable ();
+	if (curr->faults != NULL)
+		add_fault (curr->faults, class, cycles);
+	add_fault (&total, class, cycles);
+	intr_set_level (old_level);
+}
+
+/* 종료하는 프로세스 T의 통계를 해제합니다. */
+void
+faultstat_release (struct thread *t) {
+	struct faultstat *fs;
+	enum intr_level old_level;
+
+	/* faultstat_get()이 인터럽트를 끄고 복사하는 도중에는 사라지지
+	 * 않도록 포인터부터 떼어 냅니다. */
+	old_level = intr_disable ();
+	fs = t->faults;
+	t->faults = NULL;
+	intr_set_level (old_level);
+	if (fs != NULL)
+		memstat_charge (t, MEMSTAT_KERNEL, -(long) sizeof *fs);
+	free (fs);
+}
+
+/* TID 프로세스의 폴트 통계를 *FS에 복사합니다. TID가 0이면 호출한
+ * 프로세스, FAULTSTAT_ALL이면 커널 전체 합계를 뜻합니다. 해당
+ * 프로세스가 없으면 false를 반환합니다. */
+bool
+faultstat_get (tid_t tid, struct faultstat *fs) {
+	static const struct faultstat none;
+	enum intr_level old_level = intr_disable ();
+	struct thread *t = NULL;
+	bool found = true;
+
+	if (tid == FAULTSTAT_ALL)
+		*fs = total;
+	else if ((t = tid == 0 ? thread_current () : thread_find (tid)) != NULL)
+		*fs = t->faults != NULL ? *t->faults : none;
+	else
+		found = false;
+	intr_set_level (old_level);
+	return found;
+}
+
+/* 커널 전체 폴트 통계를 종류마다 한 줄씩 출력합니다. 히스토그램은
+ * 비어 있지 않은 구간만 "log2(사이클):횟수" 꼴로 보여 줍니다. */
+void
+faultstat_print_stats (void) {
+	for (int c = 0; c < FAULT_CLASS_CNT; c++) {
+		if (total.count[c] == 0)
+			continue;
+		printf ("Fault %-7s %llu, %llu cycles avg, log2 cycles:",
+				class_names[c], total.count[c],
+				total.cycles[c] / total.count[c]);
+		for (int b = 0; b < FAULT_HIST_BUCKETS; b++)
+			if (total.hist[c][b] != 0)
+				printf (" %d:%u", b, total.hist[c][b]);
+		printf ("\n");
+	}
+}
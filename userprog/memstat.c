@@ -0,0 +1,99 @@
+/* memstat.c: 프로세스별 메모리 사용량 집계.
+ *
+ * 페이지를 할당하거나 해제하는 곳(프레임 확보, 스왑 아웃, 페이지 테이블
+ * 생성 등)에서 memstat_charge()를 호출해 해당 프로세스의 카운터와
+ * 커널 전체 합계를 함께 갱신합니다. 스레드 페이지, VMA, struct page,
+ * 프레임 테이블 항목, zswap 항목처럼 프로세스를 위해 잡은 커널 객체는
+ * 할당하고 해제하는 곳에서 MEMSTAT_KERNEL에 바이트 단위로 집계합니다. user_page_limit(-ul)을 정할 때
+ * 참고할 수 있도록 최대 사용량도 기록합니다. */
+
+#include "userprog/memstat.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+
+/* 살아 있는 모든 프로세스의 합계와 그 최댓값. */
+static struct memstat total;
+static struct memstat total_peak;
+
+/* COUNTER에 해당하는 STAT의 필드를 반환합니다. */
+static size_t *
+counter_field (struct memstat *stat, enum memstat_counter counter) {
+	switch (counter) {
+		case MEMSTAT_RESIDENT:
+			return &stat->resident;
+		case MEMSTAT_PAGE_TABLES:
+			return &stat->page_tables;
+		case MEMSTAT_SWAPPED:
+			return &stat->swapped;
+		case MEMSTAT_MMAP:
+			return &stat->mmap;
+		case MEMSTAT_KERNEL:
+			return &stat->kernel;
+		default:
+			NOT_REACHED ();
+	}
+}
+
+/* T의 COUNTER를 AMOUNT만큼 더합니다(음수면 뺍니다). 단위는
+ * MEMSTAT_KERNEL이면 바이트, 나머지는 페이지입니다. */
+void
+memstat_charge (struct thread *t, enum memstat_counter counter, long amount) {
+	enum intr_level old_level;
+	size_t *mine, *sum, *peak;
+
+	if (t == NULL || amount == 0)
+		return;
+
+	old_level = intr_disable ();
+	mine = counter_field (&t->mem, counter);
+	sum = counter_field (&total, counter);
+	peak = counter_field (&total_peak, counter);
+
+	ASSERT (amount > 0 || *mine >= (size_t) -amount);
+	*mine += amount;
+	*sum += amount;
+	if (*sum > *peak)
+		*peak = *sum;
+	if (t->mem.resident > t->mem.resident_peak)
+		t->mem.resident_peak = t->mem.resident;
+	intr_set_level (old_level);
+}
+
+/* 종료하는 프로세스 T에 남아 있는 사용량을 전체 합계에서 뺍니다. */
+void
+memstat_release (struct thread *t) {
+	static const enum memstat_counter counters[] = {
+		MEMSTAT_RESIDENT, MEMSTAT_PAGE_TABLES, MEMSTAT_SWAPPED,
+		MEMSTAT_MMAP, MEMSTAT_KERNEL,
+	};
+
+	for (size_t i = 0; i < sizeof counters / sizeof *counters; i++)
+		memstat_charge (t, counters[i], -(long) *counter_field (&t->mem, counters[i]));
+}
+
+/* TID 프로세스의 사용량을 *STAT에 복사합니다. TID가 0이면 호출한
+ * 프로세스를 뜻합니다. 해당 프로세스가 없으면 false를 반환합니다. */
+bool
+memstat_get (tid_t tid, struct memstat *stat) {
+	enum intr_level old_level = intr_disable ();
+	struct thread *t = tid == 0 ? thread_current () : thread_find (tid);
+
+	if (t != NULL)
+		*stat = t->mem;
+	intr_set_level (old_level);
+	return t != NULL;
+}
+
+/* 커널 전체 메모리 사용량을 출력합니다. */
+void
+memstat_print_stats (void) {
+	printf ("Memory: %zu resident (peak %zu), %zu page table, "
+			"%zu swapped, %zu mmap pages, %zu kernel bytes in use\n",
+			total.resident, total_peak.resident, total.page_tables,
+			total.swapped, total.mmap, total.kernel);
+	printf ("Memory: peak %zu page table, %zu swapped, %zu mmap pages, "
+			"%zu kernel bytes\n",
+			total_peak.page_tables, total_peak.swapped, total_peak.mmap,
+			total_peak.kernel);
+}
@@ -8,6 +8,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include "userprog/gdt.h"
+#include "userprog/faultstat.h"
+#include "userprog/memstat.h"
 #include "userprog/tss.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
@@ -15,24 +17,36 @@
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "threads/vaddr.h"
 #include "intrinsic.h"
 #ifdef VM
+#include <madvise.h>
 #include "vm/vm.h"
 #endif
 
+/* 명령행 인자 개수의 상한. */
+#define ARGV_MAX 64
+
 static void process_cleanup (void);
 static bool load (const char *file_name, struct intr_frame *if_);
+static bool push_args (struct intr_frame *if_, int argc, char **argv);
 static void initd (void *f_name);
 static void __do_fork (void *);
+static void spawnd (void *cmdline);
+static void user_if_init (struct intr_frame *if_);
+static struct thread *get_child (tid_t tid);
 
 /* initd 및 기타 프로세스를 위한 일반 프로세스 초기화 프로그램입니다. */
 static void
 process_init (void) {
 	struct thread *current = thread_current ();
+
+	faultstat_init (current);
 }
 
 /* FILE_NAME에서 로드된 첫 번째 사용자 영역 프로그램인 "initd"를 시작합니다.
@@ -61,6 +75,7 @@ process_create_initd (const char *file_name) {
 /* 첫 번째 사용자 프로세스를 시작하는 스레드 함수입니다. */
 static void
 initd (void *f_name) {
+	thread_current ()->is_process = true;
 #ifdef VM
 	supplemental_page_table_init (&thread_current ()->spt);
 #endif
@@ -75,36 +90,126 @@ initd (void *f_name) {
 /* 현재 프로세스를 `name`으로 복제합니다. 새 프로세스의 스레드 ID를 반환하거나,
  * 스레드를 생성할 수 없는 경우 TID_ERROR를 반환합니다. */
 tid_t
-process_fork (const char *name, struct intr_frame *if_ UNUSED) {
+process_fork (const char *name, struct intr_frame *if_) {
+	struct thread *curr = thread_current ();
+	struct thread *child;
+	tid_t tid;
+
+	/* 자식은 부모의 사용자 레지스터를 그대로 이어받습니다. */
+	memcpy (&curr->parent_if, if_, sizeof *if_);
+
 	/* 현재 스레드를 새 스레드로 복제합니다.*/
-	return thread_create (name,
-			PRI_DEFAULT, __do_fork, thread_current ());
+	tid = thread_create (name, PRI_DEFAULT, __do_fork, curr);
+	if (tid == TID_ERROR)
+		return TID_ERROR;
+
+	/* 자식이 주소 공간을 다 복제할 때까지 돌아가지 않습니다.
+	 * 자식은 부모가 거둘 때까지 사라지지 않으므로 CHILD는 유효합니다.
+	 * 성공한 자식이 곧바로 exit(-1)할 수도 있으므로 exit_status가 아니라
+	 * fork_ok로 성공 여부를 판단합니다. */
+	child = get_child (tid);
+	sema_down (&child->fork_sema);
+	if (!child->fork_ok) {
+		process_wait (tid);
+		return TID_ERROR;
+	}
+	return tid;
+}
+
+/* 현재 스레드의 자식 중 TID인 스레드를 찾습니다. 없으면 NULL을 반환합니다. */
+static struct thread *
+get_child (tid_t tid) {
+	struct thread *curr = thread_current ();
+	struct thread *child = NULL;
+	struct list_elem *e;
+	enum intr_level old_level;
+
+	/* 커널 스레드인 자식은 스스로 목록에서 빠지므로 인터럽트를 끄고 찾습니다. */
+	old_level = intr_disable ();
+	for (e = list_begin (&curr->child_list); e != list_end (&curr->child_list);
+			e = list_next (e)) {
+		struct thread *t = list_entry (e, struct thread, child_elem);
+		if (t->tid == tid) {
+			child = t;
+			break;
+		}
+	}
+	intr_set_level (old_level);
+	return child;
 }
 
 #ifndef VM
 /* 이 함수를 pml4_for_each에 전달하여 부모 주소 공간을 복제합니다.
- * 이는 프로젝트 2에만 적용됩니다. */
+ * 이는 프로젝트 2에만 적용됩니다.
+ *
+ * 페이지를 복사하지 않고 부모의 물리 페이지를 자식에게도 매핑합니다(copy-on-write).
+ * 쓰기 가능했던 페이지는 양쪽 모두 읽기 전용으로 바꾸고 PTE_COW를 표시해 두면,
+ * 먼저 쓰는 쪽이 process_handle_cow()에서 자기 복사본을 만듭니다.
+ * 페이지가 몇 번 공유되었는지는 palloc이 세므로, 마지막 사용자가 해제할 때에야
+ * 실제로 반환됩니다. */
 static bool
 duplicate_pte (uint64_t *pte, void *va, void *aux) {
 	struct thread *current = thread_current ();
 	struct thread *parent = (struct thread *) aux;
 	void *parent_page;
-	void *newpage;
-	bool writable;
+	bool cow;
 
-	/* 1. TODO: parent_page가 커널 페이지인 경우 즉시 반환합니다. */
+	/* 1. 커널 페이지는 모든 페이지 테이블이 이미 공유합니다. */
+	if (is_kern_pte (pte))
+		return true;
 
 	/* 2. 부모 페이지 맵 레벨 4에서 VA 해결합니다. */
 	parent_page = pml4_get_page (parent->pml4, va);
 
-	/* 3. TODO: 자식 페이지에 새로운 PAL_USER 페이지를 할당하고 결과를 NEWPAGE로 설정합니다. */
+	/* 3. 쓰기 가능한 페이지라면 부모 쪽부터 쓰기 보호합니다. */
+	cow = is_writable (pte) || (*pte & PTE_COW) != 0;
+	if (cow) {
+		*pte |= PTE_COW;
+		pml4_set_writable (parent->pml4, va, false);
+	}
+
+	/* 4. 같은 페이지를 자식 페이지 테이블에 읽기 전용으로 추가합니다. */
+	if (!pml4_set_page (current->pml4, va, parent_page, false))
+		return false;
+	if (cow)
+		*pml4e_walk (current->pml4, (uint64_t) va, 0) |= PTE_COW;
+
+	/* 5. 자식의 pml4_destroy()도 이 페이지를 해제하므로 참조를 하나 늘립니다. */
+	palloc_share_page (parent_page);
+	memstat_charge (current, MEMSTAT_RESIDENT, 1);
+	return true;
+}
+
+/* 사용자 주소 ADDR의 쓰기 보호 폴트가 fork로 공유 중인 페이지에서 났다면
+ * 처리하고 true를 반환합니다. 다른 프로세스도 쓰고 있는 페이지라면 복사본을
+ * 만들어 쓰기 가능하게 매핑하고, 마지막 남은 사용자라면 복사 없이 쓰기 권한만
+ * 되돌립니다. */
+bool
+process_handle_cow (void *addr) {
+	struct thread *curr = thread_current ();
+	void *upage = pg_round_down (addr);
+	uint64_t *pte;
+	void *kpage;
 
-	/* 4. TODO: 부모 페이지를 새 페이지에 복제하고 부모 페이지가 
-	 * 쓰기 가능한지 확인합니다(결과에 따라 WRITABLE로 설정합니다). */
+	if (!is_user_vaddr (addr) || curr->pml4 == NULL)
+		return false;
+	pte = pml4e_walk (curr->pml4, (uint64_t) upage, 0);
+	if (pte == NULL || (*pte & PTE_P) == 0 || (*pte & PTE_COW) == 0)
+		return false;
 
-	/* 5. WRITABLE 권한을 가지고 VA 주소의 자식 페이지 테이블에 새 페이지를 추가합니다. */
-	if (!pml4_set_page (current->pml4, va, newpage, writable)) {
-		/* 6. TODO: 페이지 삽입에 실패하면 오류 처리를 수행합니다. */
+	kpage = ptov (PTE_ADDR (*pte));
+	if (palloc_page_refcnt (kpage) > 1) {
+		void *newpage = palloc_get_page (PAL_USER);
+		if (newpage == NULL)
+			return false;
+		memcpy (newpage, kpage, PGSIZE);
+
+		/* 새 PTE에는 PTE_COW가 없습니다. */
+		pml4_set_page (curr->pml4, upage, newpage, true);
+		palloc_free_page (kpage);
+	} else {
+		*pte &= ~(uint64_t) PTE_COW;
+		pml4_set_writable (curr->pml4, upage, true);
 	}
 	return true;
 }
@@ -118,12 +223,15 @@ __do_fork (void *aux) {
 	struct intr_frame if_;
 	struct thread *parent = (struct thread *) aux;
 	struct thread *current = thread_current ();
-	/* TODO: 어떻게든 parent_if를 전달합니다. (즉, process_fork()의 if_) */
-	struct intr_frame *parent_if;
+	/* 부모는 fork_sema에서 기다리는 동안 parent_if를 건드리지 않습니다. */
+	struct intr_frame *parent_if = &parent->parent_if;
 	bool succ = true;
 
-	/* 1. CPU 컨텍스트를 로컬 스택으로 읽습니다. */
+	current->is_process = true;
+
+	/* 1. CPU 컨텍스트를 로컬 스택으로 읽습니다. 자식의 fork()는 0을 반환합니다. */
 	memcpy (&if_, parent_if, sizeof (struct intr_frame));
+	if_.R.rax = 0;
 
 	/* 2. Duplicate PT */
 	current->pml4 = pml4_create();
@@ -140,17 +248,22 @@ __do_fork (void *aux) {
 		goto error;
 #endif
 
-	/* TODO: 코드를 여기에 입력하세요.
-	 * TODO: 힌트) 파일 객체를 복제하려면 include/filesys/file.h에서 `file_duplicate`를 사용하세요.
-	 * TODO:       이 함수가 부모의 리소스를 성공적으로 복제할 때까지
-	 * TODO:       부모는 fork()에서 반환되어서는 안 됩니다. */
+	/* TODO: 힌트) 파일 객체를 복제하려면 include/filesys/file.h에서 `file_duplicate`를 사용하세요.
+	 * TODO:       (아직 파일 디스크립터 테이블이 없습니다.) */
 
 	process_init ();
 
-	/* 마지막으로 새로 만든 프로세스로 전환합니다. */
-	if (succ)
+	/* 마지막으로 새로 만든 프로세스로 전환합니다.
+	 * 그 전에 fork()에서 기다리는 부모를 깨웁니다. */
+	if (succ) {
+		current->fork_ok = true;
+		sema_up (&current->fork_sema);
 		do_iret (&if_);
+	}
 error:
+	current->exit_status = TID_ERROR;
+	current->fork_ok = false;
+	sema_up (&current->fork_sema);
 	thread_exit ();
 }
 
@@ -164,12 +277,13 @@ process_exec (void *f_name) {
 	/* 스레드 구조체에서는 intr_frame을 사용할 수 없습니다.
      * 현재 스레드가 재스케줄링될 때 실행 정보가 멤버에 저장되기 때문입니다. */
 	struct intr_frame _if;
-	_if.ds = _if.es = _if.ss = SEL_UDSEG;
-	_if.cs = SEL_UCSEG;
-	_if.eflags = FLAG_IF | FLAG_MBS;
+	user_if_init (&_if);
 
 	/* 우리는 먼저 현재 컨텍스트를 죽입니다 */
 	process_cleanup ();
+#ifdef VM
+	supplemental_page_table_init (&thread_current ()->spt);
+#endif
 
 	/* 그리고 바이너리를 로드합니다 */
 	success = load (file_name, &_if);
@@ -184,6 +298,74 @@ process_exec (void *f_name) {
 	NOT_REACHED ();
 }
 
+/* 사용자 모드로 돌아갈 IF_의 세그먼트와 플래그를 채웁니다. */
+static void
+user_if_init (struct intr_frame *if_) {
+	if_->ds = if_->es = if_->ss = SEL_UDSEG;
+	if_->cs = SEL_UCSEG;
+	if_->eflags = FLAG_IF | FLAG_MBS;
+}
+
+/* CMDLINE 프로그램을 새 자식 프로세스로 실행하고 스레드 ID를 반환합니다.
+ * fork 후 exec와 결과는 같지만, 부모 주소 공간을 복제했다가 버리는 대신
+ * 자식이 빈 주소 공간에 곧바로 프로그램을 적재합니다.
+ * 적재가 끝날 때까지 기다렸다가, 실패했으면 TID_ERROR를 반환합니다. */
+tid_t
+process_spawn (const char *cmdline) {
+	struct thread *child;
+	char *cmd_copy;
+	tid_t tid;
+
+	cmd_copy = palloc_get_page (0);
+	if (cmd_copy == NULL)
+		return TID_ERROR;
+	strlcpy (cmd_copy, cmdline, PGSIZE);
+
+	tid = thread_create (cmd_copy, PRI_DEFAULT, spawnd, cmd_copy);
+	if (tid == TID_ERROR) {
+		palloc_free_page (cmd_copy);
+		return TID_ERROR;
+	}
+
+	/* fork와 같이 fork_sema와 fork_ok로 적재 결과를 받습니다. */
+	child = get_child (tid);
+	sema_down (&child->fork_sema);
+	if (!child->fork_ok) {
+		process_wait (tid);
+		return TID_ERROR;
+	}
+	return tid;
+}
+
+/* process_spawn()이 만든 자식 프로세스의 스레드 함수입니다. */
+static void
+spawnd (void *cmdline) {
+	struct thread *curr = thread_current ();
+	struct intr_frame if_;
+	bool success;
+
+	curr->is_process = true;
+#ifdef VM
+	supplemental_page_table_init (&curr->spt);
+#endif
+	process_init ();
+
+	user_if_init (&if_);
+	success = load (cmdline, &if_);
+	palloc_free_page (cmdline);
+	if (!success) {
+		curr->exit_status = TID_ERROR;
+		curr->fork_ok = false;
+		sema_up (&curr->fork_sema);
+		thread_exit ();
+	}
+
+	curr->fork_ok = true;
+	sema_up (&curr->fork_sema);
+	do_iret (&if_);
+	NOT_REACHED ();
+}
+
 
 /* 스레드 TID가 종료될 때까지 기다리고 종료 상태를 반환합니다.
  * 커널에 의해 종료된 경우(예: 예외로 인해 종료된 경우) -1을 반환합니다.
@@ -191,24 +373,61 @@ process_exec (void *f_name) {
  * 주어진 TID에 대해 process_wait()가 이미 성공적으로 호출된 경우,
  * 대기하지 않고 즉시 -1을 반환합니다.
  *
- * 이 함수는 문제 2-2에서 구현될 것입니다.
- * 현재로서는 아무 작업도 수행하지 않습니다. */
+ *
+ * 자식 프로세스는 종료한 뒤에도 부모가 여기서 상태를 가져갈 때까지
+ * 스레드 구조체를 남겨 둡니다(wait_sema, exit_sema). */
 int
-process_wait (tid_t child_tid UNUSED) {
-	/* XXX: Hint) pintos는 process_wait(initd)가 발생하면 종료되므로,
-	 * XXX:       process_wait를 구현하기 전에 여기에 무한 루프를 추가하는 것이 좋습니다. */
-	return -1;
+process_wait (tid_t child_tid) {
+	struct thread *child = get_child (child_tid);
+	enum intr_level old_level;
+	int status;
+
+	if (child == NULL)
+		return -1;
+
+	sema_down (&child->wait_sema);
+	status = child->exit_status;
+
+	old_level = intr_disable ();
+	list_remove (&child->child_elem);
+	intr_set_level (old_level);
+	sema_up (&child->exit_sema);
+	return status;
 }
 
 /* 프로세스를 종료합니다. 이 함수는 thread_exit()에 의해 호출됩니다. */
 void
 process_exit (void) {
 	struct thread *curr = thread_current ();
-	/* TODO: 여기에 코드를 입력하세요.
-	 * TODO: 프로세스 종료 메시지를 구현하세요(project2/process_termination.html 참조).
-	 * TODO: 여기에 프로세스 리소스 정리를 구현하는 것이 좋습니다. */
+	enum intr_level old_level;
+	bool orphan;
+
+	if (curr->is_process)
+		printf ("%s: exit(%d)\n", curr->name, curr->exit_status);
 
 	process_cleanup ();
+	faultstat_release (curr);
+	memstat_release (curr);
+
+	/* 아직 거두지 않은 자식들은 더 기다릴 부모가 없으니 풀어 줍니다.
+	 * 목록에서 뺀 child_elem은 NULL로 비워 고아임을 표시합니다. */
+	old_level = intr_disable ();
+	while (!list_empty (&curr->child_list)) {
+		struct thread *child = list_entry (list_pop_front (&curr->child_list),
+				struct thread, child_elem);
+		child->child_elem.prev = child->child_elem.next = NULL;
+		sema_up (&child->exit_sema);
+	}
+	orphan = curr->child_elem.next == NULL;
+	if (!orphan && !curr->is_process)
+		list_remove (&curr->child_elem);
+	intr_set_level (old_level);
+
+	/* 부모가 process_wait()로 종료 상태를 가져갈 때까지 기다립니다. */
+	if (!orphan && curr->is_process) {
+		sema_up (&curr->wait_sema);
+		sema_down (&curr->exit_sema);
+	}
 }
 
 /* 현재 프로세스의 리소스를 해제합니다. */
@@ -232,6 +451,10 @@ process_cleanup (void) {
 		curr->pml4 = NULL;
 		pml4_activate (NULL);
 		pml4_destroy (pml4);
+#ifndef VM
+		/* pml4_destroy()가 매핑된 사용자 페이지도 모두 해제했습니다. */
+		memstat_charge (curr, MEMSTAT_RESIDENT, -(long) curr->mem.resident);
+#endif
 	}
 }
 
@@ -239,8 +462,12 @@ process_cleanup (void) {
  * 이 함수는 모든 컨텍스트 전환 시 호출됩니다. */
 void
 process_activate (struct thread *next) {
-	/* 스레드의 페이지 테이블을 활성화합니다. */
-	pml4_activate (next->pml4);
+	/* 스레드의 페이지 테이블을 활성화합니다.
+	 * 커널 스레드는 사용자 메모리에 접근하지 않으므로 직전 주소 공간을
+	 * 그대로 빌려 씁니다(lazy TLB). 커널 스레드를 거쳐 같은 프로세스로
+	 * 돌아오면 CR3를 다시 읽지 않습니다. */
+	if (next->pml4 != NULL)
+		pml4_activate (next->pml4);
 
 	/* 인터럽트 처리에 사용할 스레드의 커널 스택을 설정합니다 */
 	tss_update (next);
@@ -303,8 +530,12 @@ static bool validate_segment (const struct Phdr *, struct file *);
 static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		uint32_t read_bytes, uint32_t zero_bytes,
 		bool writable);
+#ifdef VM
+static void prefault_segments (const struct Phdr *phdrs, int phnum);
+#endif
 
 /* FILE_NAME에서 ELF 실행 파일을 현재 스레드로 로드합니다.
+ * FILE_NAME은 공백으로 나뉜 명령행이며, 첫 단어가 실행 파일 이름입니다.
  * 실행 파일의 진입점을 *RIP에 저장하고
  * 초기 스택 포인터를 *RSP에 저장합니다.
  * 성공하면 true를 반환하고, 그렇지 않으면 false를 반환합니다. */
@@ -313,10 +544,29 @@ load (const char *file_name, struct intr_frame *if_) {
 	struct thread *t = thread_current ();
 	struct ELF ehdr;
 	struct file *file = NULL;
-	off_t file_ofs;
+	struct Phdr *phdrs = NULL;
+	off_t phdrs_size;
 	bool success = false;
+	char *cmdline, *argv[ARGV_MAX], *token, *save_ptr;
+	int argc = 0;
 	int i;
 
+	/* 명령행을 단어로 나눕니다. 스레드 이름은 프로그램 이름이 됩니다. */
+	cmdline = palloc_get_page (0);
+	if (cmdline == NULL)
+		goto done;
+	strlcpy (cmdline, file_name, PGSIZE);
+	for (token = strtok_r (cmdline, " ", &save_ptr); token != NULL;
+			token = strtok_r (NULL, " ", &save_ptr)) {
+		if (argc == ARGV_MAX)
+			goto done;
+		argv[argc++] = token;
+	}
+	if (argc == 0)
+		goto done;
+	file_name = argv[0];
+	strlcpy (t->name, file_name, sizeof t->name);
+
 	/* 페이지 디렉토리를 할당하고 활성화합니다. */
 	t->pml4 = pml4_create ();
 	if (t->pml4 == NULL)
@@ -342,18 +592,20 @@ load (const char *file_name, struct intr_frame *if_) {
 		goto done;
 	}
 
-	/* 프로그램 헤더를 읽습니다. */
-	file_ofs = ehdr.e_phoff;
-	for (i = 0; i < ehdr.e_phnum; i++) {
-		struct Phdr phdr;
-
-		if (file_ofs < 0 || file_ofs > file_length (file))
+	/* 프로그램 헤더 테이블을 한 번에 읽습니다. */
+	phdrs_size = ehdr.e_phnum * sizeof *phdrs;
+	if (ehdr.e_phoff > (uint64_t) file_length (file))
+		goto done;
+	if (phdrs_size > 0) {
+		phdrs = malloc (phdrs_size);
+		if (phdrs == NULL
+				|| file_read_at (file, phdrs, phdrs_size, ehdr.e_phoff) != phdrs_size)
 			goto done;
-		file_seek (file, file_ofs);
+	}
+
+	for (i = 0; i < ehdr.e_phnum; i++) {
+		struct Phdr phdr = phdrs[i];
 
-		if (file_read (file, &phdr, sizeof phdr) != sizeof phdr)
-			goto done;
-		file_ofs += sizeof phdr;
 		switch (phdr.p_type) {
 			case PT_NULL:
 			case PT_NOTE:
@@ -395,6 +647,14 @@ load (const char *file_name, struct intr_frame *if_) {
 		}
 	}
 
+#ifdef VM
+	/* 작은 프로그램은 첫 폴트를 기다리지 않고 미리 읽어 둡니다. */
+	prefault_segments (phdrs, ehdr.e_phnum);
+
+	/* 힙은 적재한 세그먼트 바로 위에서 시작합니다. */
+	vm_heap_init ();
+#endif
+
 	/* 스택 설정. */
 	if (!setup_stack (if_))
 		goto done;
@@ -402,17 +662,59 @@ load (const char *file_name, struct intr_frame *if_) {
 	/* 시작 주소. */
 	if_->rip = ehdr.e_entry;
 
-	/* TODO: 코드를 여기에 입력하세요.
-	 * TODO: 인수 전달을 구현합니다. (project2/argument_passing.html 참조) */
+	/* 인자를 스택에 올립니다. */
+	if (!push_args (if_, argc, argv))
+		goto done;
 
 	success = true;
 
 done:
 	/* 우리는 화물이 성공적으로 도착하든 실패하든 여기에 도착합니다. */
+	free (phdrs);
 	file_close (file);
+	palloc_free_page (cmdline);
 	return success;
 }
 
+/* ARGC개의 인자 ARGV를 IF_의 사용자 스택에 올리고 %rdi에 argc를,
+ * %rsi에 argv를 넣습니다. 문자열, 8바이트 정렬, NULL로 끝나는 argv
+ * 배열, 가짜 반환 주소 순으로 쌓습니다. 스택의 첫 페이지에 다 들어가지
+ * 않으면 false를 반환합니다. */
+static bool
+push_args (struct intr_frame *if_, int argc, char **argv) {
+	uint8_t *sp = (uint8_t *) if_->rsp;
+	char *uargv[ARGV_MAX];
+	size_t need = (argc + 2) * sizeof (char *) + sizeof (uint64_t);
+	int i;
+
+	for (i = 0; i < argc; i++)
+		need += strlen (argv[i]) + 1;
+	if (need > PGSIZE)
+		return false;
+
+	for (i = argc - 1; i >= 0; i--) {
+		size_t len = strlen (argv[i]) + 1;
+		sp -= len;
+		memcpy (sp, argv[i], len);
+		uargv[i] = (char *) sp;
+	}
+	sp = (uint8_t *) ROUND_DOWN ((uintptr_t) sp, sizeof (char *));
+
+	sp -= sizeof (char *);
+	*(char **) sp = NULL;
+	for (i = argc - 1; i >= 0; i--) {
+		sp -= sizeof (char *);
+		*(char **) sp = uargv[i];
+	}
+	if_->R.rdi = argc;
+	if_->R.rsi = (uint64_t) sp;
+
+	sp -= sizeof (void *);
+	*(void **) sp = NULL;
+	if_->rsp = (uint64_t) sp;
+	return true;
+}
+
 
 /* PHDR이 FILE에 유효하고 로드 가능한 세그먼트를 설명하는지 확인하고, 
  * 그렇다면 true를 반환하고, 그렇지 않으면 false를 반환합니다. */
@@ -476,10 +778,34 @@ static bool install_page (void *upage, void *kpage, bool writable);
 static bool
 load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		uint32_t read_bytes, uint32_t zero_bytes, bool writable) {
+	size_t page_cnt = (read_bytes + zero_bytes) / PGSIZE;
+	uint8_t *kpages;
+	size_t i;
+
 	ASSERT ((read_bytes + zero_bytes) % PGSIZE == 0);
 	ASSERT (pg_ofs (upage) == 0);
 	ASSERT (ofs % PGSIZE == 0);
 
+	/* 연속된 페이지를 한꺼번에 얻을 수 있으면 세그먼트 전체를 한 번의
+	 * 읽기로 채웁니다. 파일 시스템은 디스크에서 이어진 섹터들을 한
+	 * 명령으로 읽어 옵니다. */
+	kpages = palloc_get_multiple (PAL_USER, page_cnt);
+	if (kpages != NULL) {
+		if (file_read_at (file, kpages, read_bytes, ofs) != (off_t) read_bytes) {
+			palloc_free_multiple (kpages, page_cnt);
+			return false;
+		}
+		memset (kpages + read_bytes, 0, zero_bytes);
+		for (i = 0; i < page_cnt; i++)
+			if (!install_page (upage + i * PGSIZE, kpages + i * PGSIZE, writable)) {
+				/* 이미 설치한 페이지는 pml4_destroy()가 해제합니다. */
+				palloc_free_multiple (kpages + i * PGSIZE, page_cnt - i);
+				return false;
+			}
+		return true;
+	}
+
+	/* 그렇지 않으면 한 페이지씩 읽어 들입니다. */
 	file_seek (file, ofs);
 	while (read_bytes > 0 || zero_bytes > 0) {
 		/* 이 페이지를 어떻게 채울지 계산해 보세요.
@@ -543,21 +869,17 @@ install_page (void *upage, void *kpage, bool writable) {
 
 	/* Verify that there's not already a page at that virtual
 	 * address, then map our page there. */
-	return (pml4_get_page (t->pml4, upage) == NULL
-			&& pml4_set_page (t->pml4, upage, kpage, writable));
+	if (pml4_get_page (t->pml4, upage) != NULL
+			|| !pml4_set_page (t->pml4, upage, kpage, writable))
+		return false;
+	memstat_charge (t, MEMSTAT_RESIDENT, 1);
+	return true;
 }
 #else
 /* From here, codes will be used after project 3.
  * If you want to implement the function for only project 2, implement it on the
  * upper block. */
 
-static bool
-lazy_load_segment (struct page *page, void *aux) {
-	/* TODO: Load the segment from the file */
-	/* TODO: This called when the first page fault occurs on address VA. */
-	/* TODO: VA is available when calling this function. */
-}
-
 /* Loads a segment starting at offset OFS in FILE at address
  * UPAGE.  In total, READ_BYTES + ZERO_BYTES bytes of virtual
  * memory are initialized, as follows:
@@ -579,25 +901,37 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 	ASSERT (pg_ofs (upage) == 0);
 	ASSERT (ofs % PGSIZE == 0);
 
-	while (read_bytes > 0 || zero_bytes > 0) {
-		/* Do calculate how to fill this page.
-		 * We will read PAGE_READ_BYTES bytes from FILE
-		 * and zero the final PAGE_ZERO_BYTES bytes. */
-		size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-		size_t page_zero_bytes = PGSIZE - page_read_bytes;
+	/* The whole segment becomes one area; its pages are read in
+	 * on their first fault.  A read-only segment is file-backed, so
+	 * its pages can be dropped instead of swapped, and its frames are
+	 * shared with every process that runs the same program. */
+	if (!writable && read_bytes > 0)
+		return vm_map (upage, read_bytes + zero_bytes, VM_FILE, false, VMA_TEXT,
+				file, ofs, read_bytes);
+	return vm_map (upage, read_bytes + zero_bytes, VM_ANON, writable, 0,
+			read_bytes > 0 ? file : NULL, ofs, read_bytes);
+}
 
-		/* TODO: Set up aux to pass information to the lazy_load_segment. */
-		void *aux = NULL;
-		if (!vm_alloc_page_with_initializer (VM_ANON, upage,
-					writable, lazy_load_segment, aux))
-			return false;
+/* Reads in the file-backed pages of the loadable segments among the
+ * PHNUM program headers in PHDRS, if the segments span no more than
+ * exec_prefault_pages pages, so a small program takes no faults to
+ * get going.  Pages go into free frames only; the rest stay lazy. */
+static void
+prefault_segments (const struct Phdr *phdrs, int phnum) {
+	size_t page_cnt = 0;
+	int i;
 
-		/* Advance. */
-		read_bytes -= page_read_bytes;
-		zero_bytes -= page_zero_bytes;
-		upage += PGSIZE;
-	}
-	return true;
+	for (i = 0; i < phnum; i++)
+		if (phdrs[i].p_type == PT_LOAD)
+			page_cnt += DIV_ROUND_UP ((phdrs[i].p_vaddr & PGMASK)
+					+ phdrs[i].p_memsz, PGSIZE);
+	if (page_cnt == 0 || page_cnt > exec_prefault_pages)
+		return;
+
+	for (i = 0; i < phnum; i++)
+		if (phdrs[i].p_type == PT_LOAD)
+			vm_madvise ((void *) (phdrs[i].p_vaddr & ~PGMASK),
+					(phdrs[i].p_vaddr & PGMASK) + phdrs[i].p_memsz, MADV_WILLNEED);
 }
 
 /* Create a PAGE of stack at the USER_STACK. Return true on success. */
@@ -606,10 +940,14 @@ setup_stack (struct intr_frame *if_) {
 	bool success = false;
 	void *stack_bottom = (void *) (((uint8_t *) USER_STACK) - PGSIZE);
 
-	/* TODO: Map the stack on stack_bottom and claim the page immediately.
-	 * TODO: If success, set the rsp accordingly.
-	 * TODO: You should mark the page is stack. */
-	/* TODO: Your code goes here */
+	/* The stack is an anonymous area that grows down on faults.
+	 * Its first page is claimed now, since arguments go there. */
+	if (vm_map (stack_bottom, PGSIZE, VM_ANON, true, VMA_STACK, NULL, 0, 0)
+			&& vm_claim_page (stack_bottom)) {
+		if_->rsp = USER_STACK;
+		thread_current ()->stack_bottom = stack_bottom;
+		success = true;
+	}
 
 	return success;
 }
@@ -4,17 +4,45 @@
 
 #include "userprog/syscall.h"
 #include <stdio.h>
+#include <mmap.h>
+#include <string.h>
 #include <syscall-nr.h>
+#include "filesys/off_t.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/loader.h"
 #include "userprog/gdt.h"
 #include "threads/flags.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "userprog/faultstat.h"
+#include "userprog/memstat.h"
+#include "userprog/process.h"
+#include "userprog/uaccess.h"
 #include "intrinsic.h"
+#ifdef VM
+#include "vm/vm.h"
+#endif
 
 void syscall_entry (void);
 void syscall_handler (struct intr_frame *);
 
+static char *copy_in_string (const char *ustr);
+static void sys_exit (int status);
+static tid_t sys_fork (const char *name, struct intr_frame *f);
+static void sys_exec (const char *cmdline);
+static tid_t sys_spawn (const char *cmdline);
+static int sys_write (int fd, const void *buffer, unsigned size);
+static int sys_memstat (tid_t pid, struct memstat *ms);
+static int sys_madvise (void *addr, size_t length, int advice);
+static int sys_faultstat (tid_t pid, struct faultstat *fs);
+static int sys_msync (void *addr, size_t length);
+static void *sys_mmap (void *addr, size_t length, int writable, int fd,
+		off_t offset);
+static void sys_munmap (void *addr);
+static void *sys_sbrk (intptr_t increment);
+
 /* 시스템 콜.
  *
  * 이전에는 시스템 호출 서비스가 인터럽트 핸들러(예: 리눅스의 int 0x80)에 의해 처리되었습니다.
@@ -40,10 +68,238 @@ syscall_init (void) {
 			FLAG_IF | FLAG_TF | FLAG_DF | FLAG_IOPL | FLAG_AC | FLAG_NT);
 }
 
-/* 주요 시스템 호출 인터페이스 */
+/* 주요 시스템 호출 인터페이스.
+ * 시스템 콜 번호는 rax에, 인자는 rdi, rsi, rdx, r10, r8, r9 순서로 전달되며
+ * 반환값은 rax에 담아 돌려줍니다. */
 void 
-syscall_handler (struct intr_frame *f UNUSED) {
-	// TODO: 여기에 구현하면 됩니다.
-	printf ("system call!\n");
+syscall_handler (struct intr_frame *f) {
+#ifdef VM
+	/* 커널 안에서 난 페이지 폴트가 스택 확장인지 판단할 때 씁니다. */
+	thread_current ()->stack_pointer = (void *) f->rsp;
+#endif
+	switch (f->R.rax) {
+		case SYS_EXIT:
+			sys_exit ((int) f->R.rdi);
+			break;
+		case SYS_FORK:
+			f->R.rax = sys_fork ((const char *) f->R.rdi, f);
+			break;
+		case SYS_EXEC:
+			sys_exec ((const char *) f->R.rdi);
+			break;
+		case SYS_SPAWN:
+			f->R.rax = sys_spawn ((const char *) f->R.rdi);
+			break;
+		case SYS_WAIT:
+			f->R.rax = process_wait ((tid_t) f->R.rdi);
+			break;
+		case SYS_WRITE:
+			f->R.rax = sys_write ((int) f->R.rdi, (const void *) f->R.rsi,
+					(unsigned) f->R.rdx);
+			break;
+		case SYS_MEMSTAT:
+			f->R.rax = sys_memstat ((tid_t) f->R.rdi, (struct memstat *) f->R.rsi);
+			break;
+		case SYS_MADVISE:
+			f->R.rax = sys_madvise ((void *) f->R.rdi, (size_t) f->R.rsi,
+					(int) f->R.rdx);
+			break;
+		case SYS_FAULTSTAT:
+			f->R.rax = sys_faultstat ((tid_t) f->R.rdi,
+					(struct faultstat *) f->R.rsi);
+			break;
+		case SYS_MSYNC:
+			f->R.rax = sys_msync ((void *) f->R.rdi, (size_t) f->R.rsi);
+			break;
+		case SYS_MMAP:
+			f->R.rax = (uint64_t) sys_mmap ((void *) f->R.rdi, (size_t) f->R.rsi,
+					(int) f->R.rdx, (int) f->R.r10, (off_t) f->R.r8);
+			break;
+		case SYS_MUNMAP:
+			sys_munmap ((void *) f->R.rdi);
+			break;
+		case SYS_SBRK:
+			f->R.rax = (uint64_t) sys_sbrk ((intptr_t) f->R.rdi);
+			break;
+		default:
+			// TODO: 여기에 구현하면 됩니다.
+			printf ("system call!\n");
+			thread_exit ();
+	}
+}
+
+/* 사용자 문자열 USTR을 새로 할당한 페이지에 복사해 반환합니다.
+ * 메모리가 없거나 문자열이 한 페이지에 다 들어가지 않으면 NULL을 반환하고,
+ * 잘못된 주소라면 프로세스를 -1 상태로 종료합니다. */
+static char *
+copy_in_string (const char *ustr) {
+	char *kstr = palloc_get_page (0);
+	long len;
+
+	if (kstr == NULL)
+		return NULL;
+	len = strncpy_from_user (kstr, ustr, PGSIZE);
+	if (len < 0 || len == PGSIZE) {
+		palloc_free_page (kstr);
+		if (len < 0)
+			sys_exit (-1);
+		return NULL;
+	}
+	return kstr;
+}
+
+/* 현재 프로세스를 STATUS로 종료합니다. */
+static void
+sys_exit (int status) {
+	thread_current ()->exit_status = status;
 	thread_exit ();
 }
+
+/* 현재 프로세스를 복제해 NAME이라는 자식을 만듭니다. 이름은 스레드
+ * 이름 길이에 맞춰 잘립니다. */
+static tid_t
+sys_fork (const char *name, struct intr_frame *f) {
+	char kname[16];
+	long len = strncpy_from_user (kname, name, sizeof kname - 1);
+
+	if (len < 0)
+		sys_exit (-1);
+	kname[len] = '\0';
+	return process_fork (kname, f);
+}
+
+/* 현재 프로세스를 CMDLINE 프로그램으로 바꿉니다. 성공하면 돌아오지 않고,
+ * 적재에 실패하면 이미 주소 공간을 버렸으므로 -1 상태로 종료합니다. */
+static void
+sys_exec (const char *cmdline) {
+	char *cmd_copy = copy_in_string (cmdline);
+
+	if (cmd_copy != NULL)
+		process_exec (cmd_copy);
+	sys_exit (-1);
+}
+
+/* CMDLINE 프로그램을 새 자식 프로세스로 실행합니다. */
+static tid_t
+sys_spawn (const char *cmdline) {
+	char *cmd_copy = copy_in_string (cmdline);
+	tid_t tid;
+
+	if (cmd_copy == NULL)
+		return TID_ERROR;
+	tid = process_spawn (cmd_copy);
+	palloc_free_page (cmd_copy);
+	return tid;
+}
+
+/* BUFFER의 SIZE 바이트를 FD에 씁니다. 아직 파일 디스크립터 테이블이
+ * 없으므로 콘솔(STDOUT_FILENO)만 지원하고, 다른 FD에는 -1을 반환합니다.
+ * 한 번에 한 페이지까지 putbuf()로 내보내 다른 출력과 섞이지 않게 하고,
+ * 쓴 바이트 수를 반환합니다. */
+static int
+sys_write (int fd, const void *buffer, unsigned size) {
+	char *kbuf;
+
+	if (fd != STDOUT_FILENO)
+		return -1;
+	if (size == 0)
+		return 0;
+	if (size > PGSIZE)
+		size = PGSIZE;
+	kbuf = palloc_get_page (0);
+	if (kbuf == NULL)
+		return -1;
+	if (copy_from_user (kbuf, buffer, size) != 0) {
+		palloc_free_page (kbuf);
+		sys_exit (-1);
+	}
+	putbuf (kbuf, size);
+	palloc_free_page (kbuf);
+	return size;
+}
+
+/* PID 프로세스의 메모리 사용량을 MS에 채웁니다. PID가 0이면 자기 자신입니다.
+ * 해당 프로세스가 없으면 -1을 반환합니다. */
+static int
+sys_memstat (tid_t pid, struct memstat *ms) {
+	struct memstat copy;
+
+	if (!memstat_get (pid, &copy))
+		return -1;
+	if (copy_to_user (ms, &copy, sizeof copy) != 0)
+		sys_exit (-1);
+	return 0;
+}
+
+/* [ADDR, ADDR + LENGTH) 범위를 앞으로 어떻게 쓸지 알려 줍니다.
+ * 범위에 매핑되지 않은 곳이 있거나 ADVICE가 잘못되었으면 -1을 반환합니다.
+ * 가상 메모리가 없으면 받아들일 조언이 없으므로 항상 -1입니다. */
+static int
+sys_madvise (void *addr UNUSED, size_t length UNUSED, int advice UNUSED) {
+#ifdef VM
+	return vm_madvise (addr, length, advice) ? 0 : -1;
+#else
+	return -1;
+#endif
+}
+
+/* PID 프로세스의 페이지 폴트 통계를 FS에 채웁니다. PID가 0이면 자기 자신,
+ * FAULTSTAT_ALL이면 커널 전체 합계입니다. 해당 프로세스가 없으면 -1을
+ * 반환합니다. */
+static int
+sys_faultstat (tid_t pid, struct faultstat *fs) {
+	struct faultstat copy;
+
+	if (!faultstat_get (pid, &copy))
+		return -1;
+	if (copy_to_user (fs, &copy, sizeof copy) != 0)
+		sys_exit (-1);
+	return 0;
+}
+
+/* [ADDR, ADDR + LENGTH) 범위에 매핑된 파일 중 수정된 페이지를 파일에 씁니다.
+ * 범위에 매핑되지 않은 곳이 있으면 -1을 반환합니다. 가상 메모리가 없으면
+ * 파일 매핑도 없으므로 항상 -1입니다. */
+static int
+sys_msync (void *addr UNUSED, size_t length UNUSED) {
+#ifdef VM
+	return vm_msync (addr, length) ? 0 : -1;
+#else
+	return -1;
+#endif
+}
+
+/* LENGTH 바이트를 ADDR에 매핑하고 그 주소를 반환합니다. ADDR이 NULL이면
+ * 커널이 빈 곳을 고릅니다. 아직 파일 디스크립터 테이블이 없으므로
+ * FD가 MAP_ANONYMOUS인 익명 매핑만 지원하며, 실패하면 NULL을 반환합니다. */
+static void *
+sys_mmap (void *addr UNUSED, size_t length UNUSED, int writable UNUSED,
+		int fd UNUSED, off_t offset UNUSED) {
+#ifdef VM
+	if (fd != MAP_ANONYMOUS || offset != 0 || !is_user_vaddr (addr))
+		return NULL;
+	return do_mmap_anon (addr, length, writable);
+#else
+	return NULL;
+#endif
+}
+
+/* mmap()으로 ADDR에 만든 매핑을 해제합니다. */
+static void
+sys_munmap (void *addr UNUSED) {
+#ifdef VM
+	do_munmap (addr);
+#endif
+}
+
+/* 프로그램 브레이크를 INCREMENT 바이트만큼 옮기고 이전 브레이크를
+ * 반환합니다. 옮길 수 없으면 (void *) -1을 반환합니다. */
+static void *
+sys_sbrk (intptr_t increment UNUSED) {
+#ifdef VM
+	void *old_brk = vm_sbrk (increment);
+	if (old_brk != NULL)
+		return old_brk;
+#endif
+	return (void *) -1;
+}
@@ -0,0 +1,81 @@
+/* uaccess.c: 사용자 메모리 복사.
+ *
+ * 시스템 콜이 넘겨받은 사용자 주소를 페이지마다 pml4_get_page()로 확인한 뒤
+ * 접근하는 대신, 주소 범위가 사용자 영역인지만 보고 곧바로 복사합니다.
+ * 매핑되지 않았거나 쓸 수 없는 페이지에 닿으면 page_fault()가 평소처럼
+ * 폴트를 처리해 보고(지연 적재, 스택 확장, copy-on-write), 그래도 안 되면
+ * 예외 테이블에서 복사 명령어의 복구 주소를 찾아 그곳으로 돌아갑니다.
+ * 그래서 정상적인 복사는 memcpy와 같은 속도로 진행됩니다. */
+
+#include "userprog/uaccess.h"
+#include <stdint.h>
+#include "threads/vaddr.h"
+
+/* copy-user.S의 복사 루틴입니다. */
+size_t uaccess_copy (void *dst, const void *src, size_t n);
+long uaccess_strncpy (char *dst, const char *src, size_t size);
+
+/* 예외 테이블 항목: 폴트가 난 명령어 주소와 이어서 실행할 주소. */
+struct ex_entry {
+	uintptr_t insn;
+	uintptr_t fixup;
+};
+
+/* 링커 스크립트가 .ex_table 섹션의 시작과 끝에 정의합니다. */
+extern const struct ex_entry __start_ex_table[], __stop_ex_table[];
+
+/* [UADDR, UADDR + N) 범위가 모두 사용자 영역이면 true를 반환합니다. */
+static bool
+user_range (const void *uaddr, size_t n) {
+	uintptr_t start = (uintptr_t) uaddr;
+
+	return start + n >= start && (n == 0 || is_user_vaddr (start + n - 1));
+}
+
+/* 사용자 주소 USRC에서 DST로 N 바이트를 복사합니다.
+ * 복사하지 못한 바이트 수를 반환하므로 성공하면 0입니다. */
+size_t
+copy_from_user (void *dst, const void *usrc, size_t n) {
+	if (!user_range (usrc, n))
+		return n;
+	return uaccess_copy (dst, usrc, n);
+}
+
+/* SRC에서 사용자 주소 UDST로 N 바이트를 복사합니다.
+ * 복사하지 못한 바이트 수를 반환하므로 성공하면 0입니다. */
+size_t
+copy_to_user (void *udst, const void *src, size_t n) {
+	if (!user_range (udst, n))
+		return n;
+	return uaccess_copy (udst, src, n);
+}
+
+/* 사용자 주소 USRC의 문자열을 널 문자까지, 최대 SIZE 바이트 DST에
+ * 복사합니다. 문자열 길이를 반환하며, SIZE 바이트 안에 끝나지 않으면
+ * SIZE를(이때 DST는 널 문자로 끝나지 않습니다), 잘못된 주소이면 -1을
+ * 반환합니다. */
+long
+strncpy_from_user (char *dst, const char *usrc, size_t size) {
+	uintptr_t start = (uintptr_t) usrc;
+
+	if (!is_user_vaddr (start))
+		return -1;
+	/* 커널 영역에 닿기 전까지만 읽습니다. */
+	if (size > KERN_BASE - start)
+		size = KERN_BASE - start;
+	return uaccess_strncpy (dst, usrc, size);
+}
+
+/* 커널 모드에서 처리하지 못한 폴트가 사용자 메모리 복사 중에 났다면
+ * F를 복구 주소로 돌려놓고 true를 반환합니다. */
+bool
+uaccess_fixup (struct intr_frame *f) {
+	const struct ex_entry *e;
+
+	for (e = __start_ex_table; e < __stop_ex_table; e++)
+		if (e->insn == f->rip) {
+			f->rip = e->fixup;
+			return true;
+		}
+	return false;
+}
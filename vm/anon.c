@@ -1,7 +1,11 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
 #include "vm/vm.h"
+#include "vm/swap.h"
+#include "vm/zswap.h"
 #include "devices/disk.h"
+#include "threads/vaddr.h"
+#include "userprog/memstat.h"
 
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
@@ -20,33 +24,127 @@ static const struct page_operations anon_ops = {
 /* Initialize the data for anonymous pages */
 void
 vm_anon_init (void) {
-	/* TODO: Set up the swap_disk. */
-	swap_disk = NULL;
+	swap_disk = disk_get (1, 1);
+	swap_init (swap_disk);
+	zswap_init ();
 }
 
 /* Initialize the file mapping */
 bool
-anon_initializer (struct page *page, enum vm_type type, void *kva) {
+anon_initializer (struct page *page, enum vm_type type UNUSED,
+		void *kva UNUSED) {
 	/* Set up the handler */
 	page->operations = &anon_ops;
 
 	struct anon_page *anon_page = &page->anon;
+	anon_page->slot = SWAP_ERROR;
+	anon_page->zentry = NULL;
+	return true;
 }
 
-/* Swap in the page by read contents from the swap disk. */
+/* Returns true if the page at VA, in the same area as PAGE, is
+ * swapped out to SLOT. */
+static bool
+swapped_to (struct page *page, void *va, size_t slot) {
+	struct page *p;
+
+	if (va < page->vma->start || va >= page->vma->end)
+		return false;
+	p = spt_find_page (&page->owner->spt, va);
+	return p != NULL && p->vma == page->vma
+		&& VM_TYPE (p->operations->type) == VM_ANON
+		&& p->frame == NULL && p->anon.slot == slot;
+}
+
+/* Picks the slots to read along with PAGE's: the neighbours of PAGE
+ * in its area that were swapped out next to it, as happens when
+ * they were evicted together.  An area advised random gets no
+ * read-ahead. */
+static void
+readahead_window (struct page *page, size_t *first, size_t *cnt) {
+	size_t slot = page->anon.slot;
+	size_t lo = slot, hi = slot + 1;
+
+	if (page->vma->flags & VMA_RANDOM) {
+		*first = slot;
+		*cnt = 1;
+		return;
+	}
+
+	while (hi - lo < SWAP_CLUSTER
+			&& swapped_to (page, (uint8_t *) page->va + (hi - slot) * PGSIZE, hi))
+		hi++;
+	while (hi - lo < SWAP_CLUSTER && lo > 0
+			&& swapped_to (page, (uint8_t *) page->va - (slot - lo + 1) * PGSIZE,
+				lo - 1))
+		lo--;
+	*first = lo;
+	*cnt = hi - lo;
+}
+
+/* Swap in the page by read contents from the compressed cache or the
+ * swap disk. */
 static bool
 anon_swap_in (struct page *page, void *kva) {
 	struct anon_page *anon_page = &page->anon;
+	size_t first, cnt;
+
+	if (zswap_load (page, kva)) {
+		memstat_charge (page->owner, MEMSTAT_SWAPPED, -1);
+		return true;
+	}
+	if (anon_page->slot == SWAP_ERROR)
+		return false;
+	readahead_window (page, &first, &cnt);
+	swap_read (anon_page->slot, kva, first, cnt);
+
+	swap_free (anon_page->slot);
+	anon_page->slot = SWAP_ERROR;
+	memstat_charge (page->owner, MEMSTAT_SWAPPED, -1);
+	return true;
 }
 
-/* Swap out the page by writing contents to the swap disk. */
+/* Swap out the page by compressing it into the cache or, failing
+ * that, writing contents to the swap disk. */
 static bool
 anon_swap_out (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+	size_t slot;
+
+	if (!zswap_store (page)) {
+		slot = swap_write (page->frame->kva);
+		if (slot == SWAP_ERROR)
+			return false;
+		anon_page->slot = slot;
+	}
+	memstat_charge (page->owner, MEMSTAT_SWAPPED, 1);
+	return true;
 }
 
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void
 anon_destroy (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+
+	vm_free_frame (page);
+	zswap_invalidate (page);
+	if (anon_page->slot != SWAP_ERROR) {
+		swap_free (anon_page->slot);
+		anon_page->slot = SWAP_ERROR;
+		memstat_charge (page->owner, MEMSTAT_SWAPPED, -1);
+	}
+}
+
+/* Maps LENGTH bytes of zero-filled memory at ADDR, or wherever there
+ * is room if ADDR is NULL.  Returns the address of the mapping, or
+ * NULL on failure.  Pages are allocated on first touch. */
+void *
+do_mmap_anon (void *addr, size_t length, bool writable) {
+	if (length == 0 || pg_ofs (addr) != 0)
+		return NULL;
+	if (addr == NULL && (addr = vm_find_gap (length)) == NULL)
+		return NULL;
+	if (!vm_map (addr, length, VM_ANON, writable, VMA_MMAP, NULL, 0, 0))
+		return NULL;
+	return addr;
 }
@@ -1,5 +1,9 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
+#include <string.h>
+#include "threads/mmu.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 #include "vm/vm.h"
 
 static bool file_backed_swap_in (struct page *page, void *kva);
@@ -26,33 +30,86 @@ file_backed_initializer (struct page *page, enum vm_type type, void *kva) {
 	page->operations = &file_ops;
 
 	struct file_page *file_page = &page->file;
+	file_page->file = page->vma->file;
+	vma_page_extent (page->vma, page->va, &file_page->offset,
+			&file_page->read_bytes);
+	return true;
+}
+
+/* Writes PAGE back to its file if the process modified it. */
+static void
+file_backed_writeback (struct page *page) {
+	struct file_page *file_page = &page->file;
+	uint64_t *pml4 = page->owner->pml4;
+
+	if (pml4 == NULL || !pml4_is_dirty (pml4, page->va))
+		return;
+	file_write_at (file_page->file, page->frame->kva, file_page->read_bytes,
+			file_page->offset);
+	pml4_set_dirty (pml4, page->va, false);
 }
 
 /* Swap in the page by read contents from the file. */
 static bool
 file_backed_swap_in (struct page *page, void *kva) {
-	struct file_page *file_page UNUSED = &page->file;
+	struct file_page *file_page = &page->file;
+
+	if (file_read_at (file_page->file, kva, file_page->read_bytes,
+				file_page->offset) != (off_t) file_page->read_bytes)
+		return false;
+	memset ((uint8_t *) kva + file_page->read_bytes, 0,
+			PGSIZE - file_page->read_bytes);
+	return true;
 }
 
 /* Swap out the page by writeback contents to the file. */
 static bool
 file_backed_swap_out (struct page *page) {
-	struct file_page *file_page UNUSED = &page->file;
+	/* The caller has already unmapped the page; its dirty bit is
+	 * still readable in the PTE. */
+	file_backed_writeback (page);
+	return true;
 }
 
 /* Destory the file backed page. PAGE will be freed by the caller. */
 static void
 file_backed_destroy (struct page *page) {
-	struct file_page *file_page UNUSED = &page->file;
+	vm_wait_io (page);
+	if (page->frame != NULL) {
+		file_backed_writeback (page);
+		vm_free_frame (page);
+	}
 }
 
-/* Do the mmap */
+/* Do the mmap.  The mapping is a single area, so its cost does not
+ * depend on LENGTH until pages are touched. */
 void *
 do_mmap (void *addr, size_t length, int writable,
 		struct file *file, off_t offset) {
+	off_t size = file_length (file);
+	size_t read_bytes;
+
+	if (addr == NULL || pg_ofs (addr) != 0 || offset < 0
+			|| offset % PGSIZE != 0 || length == 0 || size == 0)
+		return NULL;
+
+	read_bytes = offset >= size ? 0 : (size_t) (size - offset);
+	if (read_bytes > length)
+		read_bytes = length;
+	if (!vm_map (addr, length, VM_FILE, writable, 0, file, offset, read_bytes))
+		return NULL;
+	return addr;
 }
 
-/* Do the munmap */
+/* Do the munmap.  ADDR must be the start of a file mapping or of an
+ * anonymous one made by do_mmap_anon(). */
 void
 do_munmap (void *addr) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct vma *vma = spt_find_vma (spt, addr);
+
+	if (vma != NULL && vma->start == addr
+			&& ((VM_TYPE (vma->type) == VM_FILE && !(vma->flags & VMA_TEXT))
+				|| (vma->flags & VMA_MMAP)))
+		vm_unmap (spt, vma);
 }
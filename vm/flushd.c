@@ -0,0 +1,30 @@
+/* flushd.c: Periodic writeback of file mappings.
+ *
+ * Without it, a modified page of a mapped file reaches the disk only
+ * when it is evicted, synced or unmapped.  A kernel thread wakes up
+ * every flushd_ticks ticks and writes back every dirty mapped page in
+ * the frame table, batched into runs as vm_writeback() describes.
+ * Pages it cleans are also the cheapest ones for eviction to take. */
+
+#include "vm/flushd.h"
+#include "devices/timer.h"
+#include "threads/thread.h"
+#include "vm/vm.h"
+
+int64_t flushd_ticks = TIMER_FREQ;
+
+static void
+flushd (void *aux UNUSED) {
+	for (;;) {
+		timer_sleep (flushd_ticks);
+		vm_writeback ();
+	}
+}
+
+/* Starts the daemon, if it is enabled. */
+void
+flushd_init (void) {
+	if (flushd_ticks > 0
+			&& thread_create ("flushd", PRI_DEFAULT, flushd, NULL) == TID_ERROR)
+		PANIC ("flushd_init: cannot start flushd");
+}
@@ -0,0 +1,32 @@
+/* ksm.c: Same-page merging daemon.
+ *
+ * A low-priority kernel thread wakes up every KSM_INTERVAL ticks and
+ * has the frame table look at the next ksm_scan_pages frames, merging
+ * anonymous pages whose contents are identical into one copy-on-write
+ * frame.  See vm_merge_scan() for how pages are chosen and merged. */
+
+#include "vm/ksm.h"
+#include "devices/timer.h"
+#include "threads/thread.h"
+#include "vm/vm.h"
+
+/* Ticks between passes. */
+#define KSM_INTERVAL (TIMER_FREQ / 10)
+
+size_t ksm_scan_pages = 0;
+
+static void
+ksmd (void *aux UNUSED) {
+	for (;;) {
+		timer_sleep (KSM_INTERVAL);
+		vm_merge_scan (ksm_scan_pages);
+	}
+}
+
+/* Starts the daemon, if it is enabled. */
+void
+ksm_init (void) {
+	if (ksm_scan_pages > 0
+			&& thread_create ("ksmd", PRI_MIN, ksmd, NULL) == TID_ERROR)
+		PANIC ("ksm_init: cannot start ksmd");
+}
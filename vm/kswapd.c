@@ -0,0 +1,66 @@
+/* kswapd.c: Background page reclaim.
+ *
+ * A fault that finds no free frame has to evict a page itself, and
+ * may have to wait for it to be written out.  kswapd keeps that rare:
+ * it is woken when a frame allocation leaves fewer than the low
+ * watermark of user pages free, and evicts pages until the high
+ * watermark is free again.  Faults then evict directly only when
+ * kswapd falls behind.
+ *
+ * The frame table lock is not held while kswapd writes a page out, so
+ * faults on other pages go on in the meantime. */
+
+#include "vm/kswapd.h"
+#include "devices/disk.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "vm/vm.h"
+
+size_t kswapd_low_pages = SIZE_MAX;
+static size_t kswapd_high_pages;
+
+static struct semaphore kswapd_sema;
+
+/* Set while kswapd waits for work.  A wakeup lost to a race with the
+ * end of a pass is harmless: the next allocation tries again. */
+static bool kswapd_idle;
+
+static void
+kswapd (void *aux UNUSED) {
+	for (;;) {
+		kswapd_idle = true;
+		sema_down (&kswapd_sema);
+		while (palloc_free_cnt (PAL_USER) < kswapd_high_pages
+				&& vm_reclaim_frame ())
+			continue;
+	}
+}
+
+/* Sets the watermarks and starts kswapd, unless it is disabled or
+ * there is no swap disk to reclaim anonymous pages to. */
+void
+kswapd_init (void) {
+	if (kswapd_low_pages == SIZE_MAX) {
+		kswapd_low_pages = palloc_pool_size (PAL_USER) / 32;
+		if (kswapd_low_pages < 2)
+			kswapd_low_pages = 2;
+	}
+	if (kswapd_low_pages == 0 || disk_get (1, 1) == NULL)
+		return;
+	kswapd_high_pages = 2 * kswapd_low_pages;
+
+	sema_init (&kswapd_sema, 0);
+	if (thread_create ("kswapd", PRI_DEFAULT, kswapd, NULL) == TID_ERROR)
+		PANIC ("kswapd_init: cannot start kswapd");
+}
+
+/* Wakes kswapd if free user pages are below the low watermark. */
+void
+kswapd_wake (void) {
+	if (kswapd_high_pages > 0 && kswapd_idle
+			&& palloc_free_cnt (PAL_USER) < kswapd_low_pages) {
+		kswapd_idle = false;
+		sema_up (&kswapd_sema);
+	}
+}
@@ -0,0 +1,199 @@
+/* swap.c: Swap space for anonymous pages on hd1:1.
+ *
+ * The swap disk is divided into page-sized slots.  Slots are handed
+ * out a cluster at a time: consecutive evictions get consecutive
+ * slots, so they can be written by one disk command and read back
+ * together later.
+ *
+ * Writes go through a write-behind buffer that holds one run of
+ * adjacent slots.  The run is written with a single command when it
+ * fills up or when the next slot is not adjacent to it.  Reads fetch
+ * a run of slots chosen by the caller into a read-ahead buffer, which
+ * later faults on the neighbouring slots are served from. */
+
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/disk.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Number of swap disk sectors that hold one page. */
+#define SECTORS_PER_PAGE (PGSIZE / DISK_SECTOR_SIZE)
+
+static struct disk *swap_disk;
+static struct bitmap *used_slots;       /* Set bit: slot holds a page. */
+static struct lock swap_lock;
+
+/* Allocation cursor: slots [next_slot, cluster_end) of the current
+ * cluster are still free. */
+static size_t next_slot;
+static size_t cluster_end;
+
+/* Write-behind run: slots [wb_first, wb_first + wb_cnt). */
+static uint8_t *wb_buf;
+static size_t wb_first;
+static size_t wb_cnt;
+
+/* Read-ahead window: slots [ra_first, ra_first + ra_cnt), of which
+ * the ones marked in ra_valid still match the disk. */
+static uint8_t *ra_buf;
+static size_t ra_first;
+static size_t ra_cnt;
+static bool ra_valid[SWAP_CLUSTER];
+
+/* Swap statistics. */
+static struct {
+	long long pages_out;        /* Pages written to swap. */
+	long long pages_in;         /* Pages read from swap. */
+	long long write_cmds;       /* Disk commands to write runs. */
+	long long read_cmds;        /* Disk commands to read runs. */
+	long long wb_hits;          /* Reads served by the write-behind run. */
+	long long ra_hits;          /* Reads served by read-ahead. */
+} swap_stats;
+
+/* Sets up swap space on DISK, which may be NULL if there is none. */
+void
+swap_init (struct disk *disk) {
+	size_t slot_cnt = 0;
+
+	swap_disk = disk;
+	if (swap_disk != NULL)
+		slot_cnt = disk_size (swap_disk) / SECTORS_PER_PAGE;
+	used_slots = bitmap_create (slot_cnt);
+	wb_buf = palloc_get_multiple (0, SWAP_CLUSTER);
+	ra_buf = palloc_get_multiple (0, SWAP_CLUSTER);
+	if (used_slots == NULL || wb_buf == NULL || ra_buf == NULL)
+		PANIC ("swap_init: out of memory");
+	lock_init (&swap_lock);
+}
+
+/* Allocates a slot, preferring the next one of the current cluster.
+ * Returns SWAP_ERROR if swap is full. */
+static size_t
+slot_alloc (void) {
+	size_t slot;
+
+	if (next_slot < cluster_end)
+		slot = next_slot++;
+	else {
+		/* Open a new cluster at the next entirely free run, or fall
+		 * back to any free slot once swap is fragmented. */
+		size_t start = bitmap_scan (used_slots, cluster_end, SWAP_CLUSTER, false);
+		if (start == BITMAP_ERROR)
+			start = bitmap_scan (used_slots, 0, SWAP_CLUSTER, false);
+		if (start != BITMAP_ERROR) {
+			slot = start;
+			next_slot = start + 1;
+			cluster_end = start + SWAP_CLUSTER;
+		} else {
+			slot = bitmap_scan (used_slots, 0, 1, false);
+			if (slot == BITMAP_ERROR)
+				return SWAP_ERROR;
+			next_slot = cluster_end = 0;
+		}
+	}
+	bitmap_mark (used_slots, slot);
+	return slot;
+}
+
+/* Forgets any read-ahead copy of SLOT. */
+static void
+ra_invalidate (size_t slot) {
+	if (slot >= ra_first && slot < ra_first + ra_cnt)
+		ra_valid[slot - ra_first] = false;
+}
+
+/* Writes the write-behind run to disk with one command. */
+static void
+wb_flush (void) {
+	if (wb_cnt == 0)
+		return;
+	disk_write_multiple (swap_disk, wb_first * SECTORS_PER_PAGE,
+			wb_cnt * SECTORS_PER_PAGE, wb_buf);
+	swap_stats.write_cmds++;
+	wb_cnt = 0;
+}
+
+/* Saves the page at KVA to swap and returns its slot, or SWAP_ERROR
+ * if swap is full.  The page may stay in the write-behind buffer for
+ * a while; swap_read() knows to look there. */
+size_t
+swap_write (const void *kva) {
+	size_t slot;
+
+	lock_acquire (&swap_lock);
+	slot = slot_alloc ();
+	if (slot != SWAP_ERROR) {
+		if (wb_cnt > 0 && slot != wb_first + wb_cnt)
+			wb_flush ();
+		if (wb_cnt == 0)
+			wb_first = slot;
+		memcpy (wb_buf + wb_cnt++ * PGSIZE, kva, PGSIZE);
+		ra_invalidate (slot);
+		if (wb_cnt == SWAP_CLUSTER)
+			wb_flush ();
+		swap_stats.pages_out++;
+	}
+	lock_release (&swap_lock);
+	return slot;
+}
+
+/* Reads SLOT into KVA.  If the page has to come from disk, the CNT
+ * slots starting at FIRST, which include SLOT, are read along with
+ * it by one command and kept for later calls. */
+void
+swap_read (size_t slot, void *kva, size_t first, size_t cnt) {
+	ASSERT (first <= slot && slot < first + cnt);
+	ASSERT (cnt <= SWAP_CLUSTER);
+
+	lock_acquire (&swap_lock);
+	if (wb_cnt > 0 && slot >= wb_first && slot < wb_first + wb_cnt) {
+		memcpy (kva, wb_buf + (slot - wb_first) * PGSIZE, PGSIZE);
+		swap_stats.wb_hits++;
+	} else if (slot >= ra_first && slot < ra_first + ra_cnt
+			&& ra_valid[slot - ra_first]) {
+		memcpy (kva, ra_buf + (slot - ra_first) * PGSIZE, PGSIZE);
+		swap_stats.ra_hits++;
+	} else {
+		size_t i;
+
+		/* The disk must be current for every slot of the run. */
+		if (wb_cnt > 0 && wb_first < first + cnt && first < wb_first + wb_cnt)
+			wb_flush ();
+		disk_read_multiple (swap_disk, first * SECTORS_PER_PAGE,
+				cnt * SECTORS_PER_PAGE, ra_buf);
+		swap_stats.read_cmds++;
+		ra_first = first;
+		ra_cnt = cnt;
+		for (i = 0; i < cnt; i++)
+			ra_valid[i] = true;
+		memcpy (kva, ra_buf + (slot - first) * PGSIZE, PGSIZE);
+	}
+	swap_stats.pages_in++;
+	lock_release (&swap_lock);
+}
+
+/* Releases SLOT for reuse. */
+void
+swap_free (size_t slot) {
+	lock_acquire (&swap_lock);
+	ASSERT (bitmap_test (used_slots, slot));
+	bitmap_reset (used_slots, slot);
+	ra_invalidate (slot);
+	lock_release (&swap_lock);
+}
+
+/* Prints swap statistics. */
+void
+swap_print_stats (void) {
+	printf ("Swap: %zu of %zu slots in use, %lld pages out in %lld writes, "
+			"%lld pages in with %lld reads (%lld read-ahead, "
+			"%lld write-behind hits)\n",
+			bitmap_count (used_slots, 0, bitmap_size (used_slots), true),
+			bitmap_size (used_slots), swap_stats.pages_out,
+			swap_stats.write_cmds, swap_stats.pages_in, swap_stats.read_cmds,
+			swap_stats.ra_hits, swap_stats.wb_hits);
+}
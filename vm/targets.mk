@@ -2,4 +2,9 @@ vm_SRC = vm/vm.c          # Main api proxy
 vm_SRC += vm/uninit.c     # Uninitialized page
 vm_SRC += vm/anon.c       # Anonymous page
 vm_SRC += vm/file.c       # File mapped page
+vm_SRC += vm/swap.c       # Swap space
+vm_SRC += vm/zswap.c      # Compressed swap cache
+vm_SRC += vm/ksm.c        # Same-page merging daemon
+vm_SRC += vm/kswapd.c     # Background page reclaim
+vm_SRC += vm/flushd.c     # Periodic writeback of mapped files
 vm_SRC += vm/inspect.c    # Testing utility
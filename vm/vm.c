@@ -1,8 +1,121 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
+#include <madvise.h>
+#include <round.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "userprog/memstat.h"
 #include "vm/vm.h"
+#include "vm/flushd.h"
 #include "vm/inspect.h"
+#include "vm/ksm.h"
+#include "vm/kswapd.h"
+#include "vm/swap.h"
+#include "vm/zswap.h"
+
+/* Lowest address the stack may grow down to. */
+#define STACK_LIMIT ((uint8_t *) USER_STACK - (1 << 20))
+
+/* Frame table.  Every frame holding a user page is on FRAME_LIST, a
+ * ring swept by CLOCK_HAND.  FRAME_LOCK guards the table and the
+ * frame links of every page.  It is not held while a page is written
+ * out, for eviction or writeback; the frame is marked evicting or
+ * writing instead, and whoever needs the page meanwhile waits on
+ * IO_DONE. */
+static struct list frame_list;
+static struct list_elem *clock_hand;
+static size_t frame_cnt;
+static struct lock frame_lock;
+static struct condition io_done;
+
+size_t fault_around_pages = 16;
+size_t exec_prefault_pages = 0;
+
+/* Shared text.  Frames holding a page of a read-only program segment
+ * are hashed by the inode, offset and length the page was read from,
+ * so that every process running the program maps the same frames.
+ * A frame leaves the table when it is evicted or freed.  Guarded by
+ * frame_lock. */
+static struct hash text_frames;
+static hash_hash_func text_hash;
+static hash_less_func text_less;
+
+/* The zero page.  A page that has never been written and would start
+ * out all zeros is mapped read-only to this one frame on a read fault;
+ * it gets a frame of its own on its first write.  The frame is not on
+ * the clock ring, is never freed, and pages mapped to it are not
+ * counted as resident.  Its page list is guarded by frame_lock. */
+static struct frame *zero_frame;
+static uint64_t zero_checksum;
+
+/* Same-page merging.  Anonymous frames found holding the same bytes on
+ * two passes of the merging scan are write-protected and hashed by
+ * contents; a page whose bytes match a frame already in the table is
+ * moved onto that frame, read-only, and its own frame is freed.  A
+ * write then goes through copy-on-write like after fork.  Guarded by
+ * frame_lock, as is MERGE_CURSOR, the scan's position in the frame
+ * ring. */
+static struct hash merged_frames;
+static struct list_elem *merge_cursor;
+static hash_hash_func merge_hash;
+static hash_less_func merge_less;
+
+/* Fault statistics. */
+static struct {
+	long long faults;           /* Not-present faults resolved. */
+	long long around;           /* Pages mapped by fault-around. */
+	long long willneed;         /* Pages read in by MADV_WILLNEED. */
+	long long dontneed;         /* Pages dropped by MADV_DONTNEED. */
+} fault_stats;
+
+/* Frame table statistics. */
+static struct {
+	long long evicted;          /* Pages taken out of their frame. */
+	long long evicted_clean;    /* ...that needed no writeback. */
+	long long reclaimed;        /* ...by kswapd, in the background. */
+	long long direct;           /* ...by a thread that needed a frame. */
+	long long scanned;          /* Frames visited by the clock hand. */
+	long long referenced;       /* Accessed bits cleared by the hand. */
+	long long cow_shared;       /* Pages shared with a child by fork. */
+	long long cow_copied;       /* Shared pages copied on a write. */
+	long long cow_reused;       /* ...taken over by the last sharer. */
+	long long text_hits;        /* Text pages found in a shared frame. */
+	long long zero_mapped;      /* Pages mapped to the zero page. */
+	long long zero_written;     /* ...later given a frame by a write. */
+	long long merge_scanned;    /* Frames looked at by the merging scan. */
+	long long merged;           /* Pages moved onto a merged frame. */
+	long long merged_zero;      /* ...or onto the zero page. */
+} frame_stats;
+
+/* Writeback of file mappings.  Dirty pages are gathered into a batch
+ * and sorted by file position; each run of consecutive pages of one
+ * file is copied into WB_BUF and written with a single call, so a
+ * mapping written front to back goes out in a few large writes rather
+ * than a page at a time.  WB_CURSOR is where the flush daemon's scan
+ * of the frame ring resumes; it is guarded by frame_lock.  Writebacks
+ * drop frame_lock while they write, so WB_LOCK serializes them and
+ * guards WB_BUF.  It is taken before frame_lock. */
+#define WB_BATCH 16
+static struct lock wb_lock;
+static uint8_t *wb_buf;
+static struct list_elem *wb_cursor;
+
+struct wb_batch {
+	struct page *pages[WB_BATCH];
+	size_t cnt;
+};
+
+/* Writeback statistics. */
+static struct {
+	long long pages;            /* Dirty mapped pages written back. */
+	long long writes;           /* Writes they took. */
+	long long passes;           /* Passes of the flush daemon. */
+} wb_stats;
 
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
@@ -15,7 +128,37 @@ vm_init (void) {
 #endif
 	register_inspect_intr ();
 	/* DO NOT MODIFY UPPER LINES. */
-	/* TODO: Your code goes here. */
+	list_init (&frame_list);
+	lock_init (&frame_lock);
+	cond_init (&io_done);
+	clock_hand = NULL;
+	if (!hash_init (&text_frames, text_hash, text_less, NULL)
+			|| !hash_init (&merged_frames, merge_hash, merge_less, NULL))
+		PANIC ("vm_init: out of memory");
+	merge_cursor = NULL;
+
+	zero_frame = malloc (sizeof *zero_frame);
+	if (zero_frame == NULL
+			|| (zero_frame->kva = palloc_get_page (PAL_ZERO)) == NULL)
+		PANIC ("vm_init: out of memory");
+	list_init (&zero_frame->pages);
+	zero_frame->refcnt = 0;
+	zero_frame->pinned = true;
+	zero_frame->evicting = false;
+	zero_frame->writing = false;
+	zero_frame->inode = NULL;
+	zero_frame->merged = false;
+	zero_checksum = hash_bytes (zero_frame->kva, PGSIZE);
+
+	lock_init (&wb_lock);
+	wb_buf = palloc_get_multiple (0, WB_BATCH);
+	if (wb_buf == NULL)
+		PANIC ("vm_init: out of memory");
+	wb_cursor = NULL;
+
+	ksm_init ();
+	kswapd_init ();
+	flushd_init ();
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -35,11 +178,29 @@ page_get_type (struct page *page) {
 /* Helpers */
 static struct frame *vm_get_victim (void);
 static bool vm_do_claim_page (struct page *page);
+static bool claim_page (struct page *, bool may_evict);
+static bool page_attach (struct page *);
+static bool zero_attach (struct page *);
 static struct frame *vm_evict_frame (void);
+static struct page *page_new (struct supplemental_page_table *,
+		struct vma *, void *va, vm_initializer *, void *aux);
+static bool vma_load_page (struct page *, void *aux);
+static void page_uncharge (struct page *);
+static bool page_pin (struct page *);
+static void page_unpin (struct page *);
+static void frame_link (struct frame *, struct page *);
+static void frame_unlink (struct page *);
+static void text_remove (struct frame *);
+static void merge_remove (struct frame *);
+static void frame_release (struct frame *);
+static void vma_writeback (struct vma *, uint8_t *start, uint8_t *end);
 
 /* Create the pending page object with initializer. If you want to create a
  * page, do not create it directly and make it through this function or
- * `vm_alloc_page`. */
+ * `vm_alloc_page`.
+ *
+ * UPAGE gets an area of its own, so the page can be found and torn down
+ * like any other. */
 bool
 vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable,
 		vm_initializer *init, void *aux) {
@@ -47,97 +208,1324 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable,
 	ASSERT (VM_TYPE(type) != VM_UNINIT)
 
 	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct vma *vma;
 
 	/* Check wheter the upage is already occupied or not. */
-	if (spt_find_page (spt, upage) == NULL) {
-		/* TODO: Create the page, fetch the initialier according to the VM type,
-		 * TODO: and then create "uninit" page struct by calling uninit_new. You
-		 * TODO: should modify the field after calling the uninit_new. */
+	if (spt_find_vma (spt, upage) != NULL)
+		return false;
+	if (!vm_map (upage, PGSIZE, type, writable, 0, NULL, 0, 0))
+		return false;
 
-		/* TODO: Insert the page into the spt. */
+	vma = spt_find_vma (spt, upage);
+	if (page_new (spt, vma, upage, init, aux) == NULL) {
+		vm_unmap (spt, vma);
+		return false;
 	}
-err:
-	return false;
+	return true;
 }
 
-/* Find VA from spt and return page. On error, return NULL. */
+/* Find VA from spt and return page. On error, return NULL.
+ * Only pages that are resident or swapped out have a struct page;
+ * use spt_find_vma() to learn whether VA is mapped at all. */
 struct page *
-spt_find_page (struct supplemental_page_table *spt UNUSED, void *va UNUSED) {
-	struct page *page = NULL;
-	/* TODO: Fill this function. */
+spt_find_page (struct supplemental_page_table *spt, void *va) {
+	struct page p;
+	struct hash_elem *e;
 
-	return page;
+	p.va = pg_round_down (va);
+	e = hash_find (&spt->pages, &p.spt_elem);
+	return e != NULL ? hash_entry (e, struct page, spt_elem) : NULL;
 }
 
 /* Insert PAGE into spt with validation. */
 bool
-spt_insert_page (struct supplemental_page_table *spt UNUSED,
-		struct page *page UNUSED) {
-	int succ = false;
-	/* TODO: Fill this function. */
-
-	return succ;
+spt_insert_page (struct supplemental_page_table *spt,
+		struct page *page) {
+	if (page->vma == NULL || hash_insert (&spt->pages, &page->spt_elem) != NULL)
+		return false;
+	list_push_back (&page->vma->pages, &page->vma_elem);
+	return true;
 }
 
 void
 spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
+	hash_delete (&spt->pages, &page->spt_elem);
+	list_remove (&page->vma_elem);
+	memstat_charge (page->owner, MEMSTAT_KERNEL, -(long) sizeof *page);
+	lock_acquire (&frame_lock);
 	vm_dealloc_page (page);
+	lock_release (&frame_lock);
+}
+
+/* Returns the area of SPT that contains VA, or NULL if VA is not
+ * mapped. */
+struct vma *
+spt_find_vma (struct supplemental_page_table *spt, void *va) {
+	struct vma key;
+	struct avl_elem *e;
+	struct vma *vma = spt->hint;
+
+	/* Faults tend to come in runs within one area. */
+	if (vma != NULL && vma->start <= va && va < vma->end)
+		return vma;
+
+	key.start = va;
+	e = avl_floor (&spt->vmas, &key.elem);
+	if (e == NULL)
+		return NULL;
+	vma = avl_entry (e, struct vma, elem);
+	if (va >= vma->end)
+		return NULL;
+	spt->hint = vma;
+	return vma;
+}
+
+/* Returns true if some area of SPT overlaps [START, END). */
+static bool
+spt_overlaps (struct supplemental_page_table *spt, void *start, void *end) {
+	struct vma key;
+	struct avl_elem *e;
+
+	key.start = start;
+	e = avl_floor (&spt->vmas, &key.elem);
+	if (e != NULL && avl_entry (e, struct vma, elem)->end > start)
+		return true;
+	e = avl_ceil (&spt->vmas, &key.elem);
+	return e != NULL && avl_entry (e, struct vma, elem)->start < end;
+}
+
+/* Maps LENGTH bytes at page-aligned START in the current process as
+ * one area of TYPE.  The first READ_BYTES bytes are read from FILE
+ * starting at OFFSET when first touched and the rest are zero; FILE
+ * may be NULL if READ_BYTES is 0.  The area keeps its own reference
+ * to FILE.  Fails if the range is not in user space or overlaps an
+ * existing area. */
+bool
+vm_map (void *start, size_t length, enum vm_type type, bool writable,
+		unsigned flags, struct file *file, off_t offset, size_t read_bytes) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	void *end = (uint8_t *) start + ROUND_UP (length, PGSIZE);
+	struct vma *vma;
+
+	ASSERT (pg_ofs (start) == 0);
+	ASSERT (read_bytes <= length);
+	ASSERT (file != NULL || read_bytes == 0);
+
+	if (start == NULL || length == 0 || end <= start
+			|| !is_user_vaddr ((uint8_t *) end - 1)
+			|| spt_overlaps (spt, start, end))
+		return false;
+
+	vma = malloc (sizeof *vma);
+	if (vma == NULL)
+		return false;
+	vma->file = NULL;
+	if (file != NULL && (vma->file = file_reopen (file)) == NULL) {
+		free (vma);
+		return false;
+	}
+	vma->start = start;
+	vma->end = end;
+	vma->type = type;
+	vma->writable = writable;
+	vma->flags = flags;
+	vma->offset = offset;
+	vma->read_bytes = read_bytes;
+	list_init (&vma->pages);
+	avl_insert (&spt->vmas, &vma->elem);
+	memstat_charge (thread_current (), MEMSTAT_KERNEL, sizeof *vma);
+	return true;
+}
+
+/* Removes VMA and every page in it from SPT.  File-backed pages are
+ * written back by their destructors. */
+void
+vm_unmap (struct supplemental_page_table *spt, struct vma *vma) {
+	vma_writeback (vma, vma->start, vma->end);
+	while (!list_empty (&vma->pages))
+		spt_remove_page (spt, list_entry (list_front (&vma->pages),
+					struct page, vma_elem));
+
+	avl_remove (&spt->vmas, &vma->elem);
+	if (spt->hint == vma)
+		spt->hint = NULL;
+	file_close (vma->file);
+	memstat_charge (thread_current (), MEMSTAT_KERNEL, -(long) sizeof *vma);
+	free (vma);
+}
+
+/* Computes where page VA of VMA comes from: *OFS receives its file
+ * offset and *READ_BYTES the number of its bytes backed by the file. */
+void
+vma_page_extent (const struct vma *vma, const void *va,
+		off_t *ofs, size_t *read_bytes) {
+	size_t skip = (const uint8_t *) va - (const uint8_t *) vma->start;
+
+	*ofs = vma->offset + skip;
+	if (vma->read_bytes <= skip)
+		*read_bytes = 0;
+	else if (vma->read_bytes - skip < PGSIZE)
+		*read_bytes = vma->read_bytes - skip;
+	else
+		*read_bytes = PGSIZE;
+}
+
+/* Creates the uninit page for VA in VMA and adds it to SPT.  INIT
+ * and AUX fill the page on its first claim. */
+static struct page *
+page_new (struct supplemental_page_table *spt, struct vma *vma, void *va,
+		vm_initializer *init, void *aux) {
+	struct page *page = malloc (sizeof *page);
+	if (page == NULL)
+		return NULL;
+
+	uninit_new (page, va, init, vma->type, aux,
+			VM_TYPE (vma->type) == VM_FILE
+			? file_backed_initializer : anon_initializer);
+	page->vma = vma;
+	page->owner = thread_current ();
+	page->writable = vma->writable;
+	if (!spt_insert_page (spt, page)) {
+		free (page);
+		return NULL;
+	}
+	memstat_charge (page->owner, MEMSTAT_KERNEL, sizeof *page);
+	return page;
+}
+
+/* Fills a freshly claimed page of an area from the area's file. */
+static bool
+vma_load_page (struct page *page, void *aux UNUSED) {
+	uint8_t *kva = page->frame->kva;
+	size_t read_bytes;
+	off_t ofs;
+
+	vma_page_extent (page->vma, page->va, &ofs, &read_bytes);
+	if (read_bytes > 0
+			&& file_read_at (page->vma->file, kva, read_bytes, ofs)
+			!= (off_t) read_bytes)
+		return false;
+	memset (kva + read_bytes, 0, PGSIZE - read_bytes);
 	return true;
 }
 
-/* Get the struct frame, that will be evicted. */
+/* Returns true if page VA of VMA is backed by its file, rather than
+ * zero-filled. */
+static bool
+vma_page_in_file (const struct vma *vma, const void *va) {
+	return vma->file != NULL
+		&& (size_t) ((const uint8_t *) va - (const uint8_t *) vma->start)
+		< vma->read_bytes;
+}
+
+/* Returns true if PAGE belongs in the shared text table. */
+static bool
+page_is_text (struct page *page) {
+	return (page->vma->flags & VMA_TEXT)
+		&& vma_page_in_file (page->vma, page->va);
+}
+
+/* Returns true if PAGE has never been claimed and would start out all
+ * zeros: a page of an anonymous area past its file data, such as bss,
+ * stack or heap, that is filled by the default initializer or none. */
+static bool
+page_is_zero (struct page *page) {
+	return VM_TYPE (page->operations->type) == VM_UNINIT
+		&& VM_TYPE (page->uninit.type) == VM_ANON
+		&& (page->uninit.init == NULL || page->uninit.init == vma_load_page)
+		&& !vma_page_in_file (page->vma, page->va);
+}
+
+/* Returns true if PAGE counts as mapped file memory. */
+static bool
+page_is_mmap (struct page *page) {
+	return page_get_type (page) == VM_FILE && !(page->vma->flags & VMA_TEXT);
+}
+
+static uint64_t
+text_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct frame *f = hash_entry (e, struct frame, text_elem);
+	uint64_t key[3] = { (uint64_t) f->inode, f->ofs, f->read_bytes };
+	return hash_bytes (key, sizeof key);
+}
+
+static bool
+text_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct frame *a = hash_entry (a_, struct frame, text_elem);
+	const struct frame *b = hash_entry (b_, struct frame, text_elem);
+
+	if (a->inode != b->inode)
+		return a->inode < b->inode;
+	if (a->ofs != b->ofs)
+		return a->ofs < b->ofs;
+	return a->read_bytes < b->read_bytes;
+}
+
+/* Sets FRAME's text key to where text page PAGE comes from. */
+static void
+text_key (struct frame *frame, struct page *page) {
+	frame->inode = file_get_inode (page->vma->file);
+	vma_page_extent (page->vma, page->va, &frame->ofs, &frame->read_bytes);
+}
+
+/* Returns the frame that already holds text page PAGE, or NULL. */
+static struct frame *
+text_lookup (struct page *page) {
+	struct frame key;
+	struct hash_elem *e;
+
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	text_key (&key, page);
+	e = hash_find (&text_frames, &key.text_elem);
+	return e != NULL ? hash_entry (e, struct frame, text_elem) : NULL;
+}
+
+/* Enters FRAME, just filled with text page PAGE, in the table.  If
+ * another frame got there first, FRAME stays private to PAGE. */
+static void
+text_insert (struct frame *frame, struct page *page) {
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	text_key (frame, page);
+	if (hash_insert (&text_frames, &frame->text_elem) != NULL)
+		frame->inode = NULL;
+}
+
+/* Takes FRAME out of the table, if it is there. */
+static void
+text_remove (struct frame *frame) {
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	if (frame->inode != NULL) {
+		hash_delete (&text_frames, &frame->text_elem);
+		frame->inode = NULL;
+	}
+}
+
+static uint64_t
+merge_hash (const struct hash_elem *e, void *aux UNUSED) {
+	return hash_entry (e, struct frame, merge_elem)->checksum;
+}
+
+static bool
+merge_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return memcmp (hash_entry (a, struct frame, merge_elem)->kva,
+			hash_entry (b, struct frame, merge_elem)->kva, PGSIZE) < 0;
+}
+
+/* Takes FRAME out of the merged table, if it is there.  Its pages
+ * stay read-only until each of them writes. */
+static void
+merge_remove (struct frame *frame) {
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	if (frame->merged) {
+		hash_delete (&merged_frames, &frame->merge_elem);
+		frame->merged = false;
+	}
+}
+
+/* Moves PAGE, the only page in its frame, onto frame TARGET, which
+ * holds the same bytes, and frees its old frame. */
+static void
+merge_page (struct page *page, struct frame *target) {
+	struct frame *frame = page->frame;
+
+	frame_unlink (page);
+	frame_link (target, page);
+	pml4_set_page (page->owner->pml4, page->va, target->kva, false);
+	if (target == zero_frame) {
+		page_uncharge (page);
+		frame_stats.merged_zero++;
+	} else
+		frame_stats.merged++;
+	frame_release (frame);
+}
+
+/* Looks at FRAME for the merging scan.  Only a frame that holds one
+ * anonymous page and has kept the same checksum since the previous
+ * pass is a candidate, so pages that are still being written are left
+ * alone.  A candidate is write-protected, then merged into the zero
+ * page or a frame with the same bytes, or else entered in the table
+ * for later candidates to merge into.  Merging compares the bytes, so
+ * a write that lands between hashing and protecting can only hide the
+ * frame from later lookups. */
+static void
+merge_frame (struct frame *frame) {
+	struct page *page;
+	struct hash_elem *e;
+	uint64_t checksum;
+
+	if (frame->pinned || frame->refcnt != 1 || frame->merged)
+		return;
+	page = list_entry (list_front (&frame->pages), struct page, frame_elem);
+	if (VM_TYPE (page->operations->type) != VM_ANON
+			|| page->owner->pml4 == NULL)
+		return;
+
+	checksum = hash_bytes (frame->kva, PGSIZE);
+	if (checksum != frame->checksum) {
+		frame->checksum = checksum;
+		return;
+	}
+	pml4_set_writable (page->owner->pml4, page->va, false);
+
+	if (checksum == zero_checksum
+			&& !memcmp (frame->kva, zero_frame->kva, PGSIZE)) {
+		merge_page (page, zero_frame);
+		return;
+	}
+	e = hash_insert (&merged_frames, &frame->merge_elem);
+	if (e != NULL)
+		merge_page (page, hash_entry (e, struct frame, merge_elem));
+	else
+		frame->merged = true;
+}
+
+/* Runs the merging scan over the next CNT frames of the frame table.
+ * The lock is dropped between frames, so faults are held up for one
+ * page's hashing at most. */
+void
+vm_merge_scan (size_t cnt) {
+	size_t i;
+
+	for (i = 0; i < cnt; i++) {
+		struct frame *frame;
+
+		lock_acquire (&frame_lock);
+		if (frame_cnt == 0) {
+			lock_release (&frame_lock);
+			break;
+		}
+		if (merge_cursor == NULL || merge_cursor == list_end (&frame_list))
+			merge_cursor = list_begin (&frame_list);
+		frame = list_entry (merge_cursor, struct frame, elem);
+		merge_cursor = list_next (merge_cursor);
+		frame_stats.merge_scanned++;
+		merge_frame (frame);
+		lock_release (&frame_lock);
+	}
+}
+
+/* Returns true if PAGE can leave its frame without being written
+ * anywhere: a file-backed page that has not been modified. */
+static bool
+page_is_clean (struct page *page) {
+	return page_get_type (page) == VM_FILE
+		&& !pml4_is_dirty (page->owner->pml4, page->va);
+}
+
+/* Returns the frame under the clock hand and advances the hand. */
+static struct frame *
+clock_advance (void) {
+	struct frame *frame;
+
+	if (clock_hand == NULL || clock_hand == list_end (&frame_list))
+		clock_hand = list_begin (&frame_list);
+	frame = list_entry (clock_hand, struct frame, elem);
+	clock_hand = list_next (clock_hand);
+	return frame;
+}
+
+/* Get the struct frame, that will be evicted.
+ *
+ * Second-chance clock: a frame whose page was accessed since the hand
+ * last passed gets its accessed bit cleared and is skipped.  Among the
+ * rest, a clean file-backed page is taken at once; the first dirty one
+ * is kept as a fallback and taken after a full sweep finds nothing
+ * cheaper.  Every skip clears a bit that only a new access can set
+ * again, so the cost per eviction is O(1) amortized.
+ *
+ * Frames shared after fork are passed over: they have no single PTE
+ * to clear.  They become candidates again once all but one sharer
+ * have written to their copy or exited.
+ *
+ * Pages of an area advised sequential get no second chance: they are
+ * expected to be used once, so they are the first to go. */
 static struct frame *
 vm_get_victim (void) {
-	struct frame *victim = NULL;
-	 /* TODO: The policy for eviction is up to you. */
+	struct frame *fallback = NULL;
+	size_t step;
 
-	return victim;
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	for (step = 0; step < 2 * frame_cnt; step++) {
+		struct frame *frame = clock_advance ();
+		struct page *page;
+
+		frame_stats.scanned++;
+		if (frame->pinned || frame->refcnt != 1)
+			continue;
+		page = list_entry (list_front (&frame->pages), struct page, frame_elem);
+		if (!(page->vma->flags & VMA_SEQUENTIAL)
+				&& pml4_is_accessed (page->owner->pml4, page->va)) {
+			pml4_set_accessed (page->owner->pml4, page->va, false);
+			frame_stats.referenced++;
+			continue;
+		}
+		if (page_is_clean (page))
+			return frame;
+		if (fallback == NULL)
+			fallback = frame;
+		if (step >= frame_cnt)
+			break;
+	}
+	return fallback;
 }
 
 /* Evict one page and return the corresponding frame.
- * Return NULL on error.*/
+ * Return NULL on error.
+ *
+ * The frame table lock is dropped while the page is written out, so
+ * faults elsewhere do not wait for this eviction's I/O.  The victim
+ * stays pinned and marked evicting meanwhile: the clock and the other
+ * scans pass over it, and anyone who needs its page waits in
+ * vm_wait_io() until it is gone. */
 static struct frame *
 vm_evict_frame (void) {
-	struct frame *victim UNUSED = vm_get_victim ();
-	/* TODO: swap out the victim and return the evicted frame. */
+	struct frame *victim = vm_get_victim ();
+	struct page *page;
+	bool clean, saved;
+
+	if (victim == NULL)
+		return NULL;
+	page = list_entry (list_front (&victim->pages), struct page, frame_elem);
 
-	return NULL;
+	/* Unmap first so the owner faults, and waits for us, instead of
+	 * writing to the page while it is being saved.  Take the frame out
+	 * of the shared tables too, so no one maps it meanwhile. */
+	clean = page_is_clean (page);
+	pml4_clear_page (page->owner->pml4, page->va);
+	text_remove (victim);
+	merge_remove (victim);
+	victim->pinned = true;
+	victim->evicting = true;
+
+	lock_release (&frame_lock);
+	saved = swap_out (page);
+	lock_acquire (&frame_lock);
+	if (!saved)
+		PANIC ("vm_evict_frame: cannot swap out page %p", page->va);
+
+	page_uncharge (page);
+	frame_unlink (page);
+	victim->evicting = false;
+	cond_broadcast (&io_done, &frame_lock);
+	frame_stats.evicted++;
+	if (clean)
+		frame_stats.evicted_clean++;
+	return victim;
+}
+
+/* Waits until PAGE is neither being evicted nor being written back.
+ * The caller must hold the frame table lock, which is released while
+ * waiting. */
+void
+vm_wait_io (struct page *page) {
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	while (page->frame != NULL
+			&& (page->frame->evicting || page->frame->writing))
+		cond_wait (&io_done, &frame_lock);
 }
 
 /* palloc() and get frame. If there is no available page, evict the page
  * and return it. This always return valid address. That is, if the user pool
  * memory is full, this function evicts the frame to get the available memory
- * space.*/
+ * space.
+ * Unless MAY_EVICT is set, returns NULL instead of evicting.
+ * Wakes kswapd when free frames run low, so that evicting here is
+ * the exception.
+ * The frame is returned pinned; the caller unpins it once the page is
+ * in place.  The frame table lock may be dropped and taken again on
+ * the way, if a page has to be evicted. */
 static struct frame *
-vm_get_frame (void) {
+vm_get_frame (bool may_evict) {
 	struct frame *frame = NULL;
-	/* TODO: Fill this function. */
+	void *kva;
+
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	kva = palloc_get_page (PAL_USER);
+	kswapd_wake ();
+	if (kva == NULL) {
+		if (!may_evict)
+			return NULL;
+		frame = vm_evict_frame ();
+		if (frame == NULL)
+			PANIC ("vm_get_frame: every frame is pinned or shared");
+		frame_stats.direct++;
+	} else {
+		frame = malloc (sizeof *frame);
+		if (frame == NULL)
+			PANIC ("vm_get_frame: out of kernel memory");
+		frame->kva = kva;
+		list_init (&frame->pages);
+		frame->refcnt = 0;
+		frame->evicting = false;
+		frame->writing = false;
+		frame->inode = NULL;
+		frame->merged = false;
+
+		/* Just behind the hand, so a new frame is the last to be
+		 * considered. */
+		if (clock_hand != NULL && clock_hand != list_end (&frame_list))
+			list_insert (clock_hand, &frame->elem);
+		else
+			list_push_back (&frame_list, &frame->elem);
+		frame_cnt++;
+	}
+	frame->pinned = true;
+	frame->checksum = 0;
 
 	ASSERT (frame != NULL);
-	ASSERT (frame->page == NULL);
+	ASSERT (frame->refcnt == 0);
 	return frame;
 }
 
-/* Growing the stack. */
+/* Evicts one page and returns its frame to the user pool, for
+ * background reclaim.  Returns false if no page can be evicted.  As in
+ * vm_evict_frame(), the frame table lock is dropped for the write. */
+bool
+vm_reclaim_frame (void) {
+	struct frame *frame;
+
+	lock_acquire (&frame_lock);
+	frame = vm_evict_frame ();
+	if (frame != NULL) {
+		frame_release (frame);
+		frame_stats.reclaimed++;
+	}
+	lock_release (&frame_lock);
+	return frame != NULL;
+}
+
+/* Adds PAGE to the pages mapped to FRAME. */
+static void
+frame_link (struct frame *frame, struct page *page) {
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	list_push_back (&frame->pages, &page->frame_elem);
+	frame->refcnt++;
+	page->frame = frame;
+	memstat_charge (page->owner, MEMSTAT_KERNEL, sizeof *frame);
+}
+
+/* Removes PAGE from the pages mapped to its frame. */
+static void
+frame_unlink (struct page *page) {
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	list_remove (&page->frame_elem);
+	page->frame->refcnt--;
+	page->frame = NULL;
+	memstat_charge (page->owner, MEMSTAT_KERNEL, -(long) sizeof (struct frame));
+}
+
+/* Unmaps PAGE from its owner and returns its frame to the user pool,
+ * unless other pages still share the frame.  Does nothing if PAGE is
+ * not resident.  The caller must hold the frame table lock, as page
+ * destructors run under it. */
+void
+vm_free_frame (struct page *page) {
+	struct frame *frame;
+
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	vm_wait_io (page);
+	frame = page->frame;
+	if (frame == NULL)
+		return;
+	if (page->owner->pml4 != NULL)
+		pml4_clear_page (page->owner->pml4, page->va);
+	frame_unlink (page);
+	if (frame == zero_frame)
+		return;
+	page_uncharge (page);
+	if (frame->refcnt == 0)
+		frame_release (frame);
+}
+
+/* Takes FRAME, which no page maps, out of the frame table and returns
+ * it to the user pool. */
 static void
-vm_stack_growth (void *addr UNUSED) {
+frame_release (struct frame *frame) {
+	ASSERT (frame->refcnt == 0);
+
+	text_remove (frame);
+	merge_remove (frame);
+	if (clock_hand == &frame->elem)
+		clock_hand = list_next (clock_hand);
+	if (merge_cursor == &frame->elem)
+		merge_cursor = list_next (merge_cursor);
+	if (wb_cursor == &frame->elem)
+		wb_cursor = list_next (wb_cursor);
+	list_remove (&frame->elem);
+	frame_cnt--;
+	palloc_free_page (frame->kva);
+	free (frame);
 }
 
-/* Handle the fault on write_protected page */
+/* Brings PAGE into memory if needed and pins its frame. */
 static bool
-vm_handle_wp (struct page *page UNUSED) {
+page_pin (struct page *page) {
+	lock_acquire (&frame_lock);
+	vm_wait_io (page);
+	while (page->frame == NULL) {
+		lock_release (&frame_lock);
+		if (!vm_do_claim_page (page))
+			return false;
+		lock_acquire (&frame_lock);
+		vm_wait_io (page);
+	}
+	page->frame->pinned = true;
+	lock_release (&frame_lock);
+	return true;
+}
+
+static void
+page_unpin (struct page *page) {
+	lock_acquire (&frame_lock);
+	page->frame->pinned = false;
+	lock_release (&frame_lock);
+}
+
+/* Prints frame table statistics. */
+void
+vm_print_stats (void) {
+	struct hash_iterator i;
+	size_t merged_pages = 0;
+
+	printf ("Frames: %zu in use, %lld evicted (%lld clean), "
+			"%lld scanned, %lld second chances\n",
+			frame_cnt, frame_stats.evicted, frame_stats.evicted_clean,
+			frame_stats.scanned, frame_stats.referenced);
+	printf ("Reclaim: %lld pages by kswapd, %lld by faulting threads\n",
+			frame_stats.reclaimed, frame_stats.direct);
+	printf ("Faults: %lld resolved, %lld more pages mapped around them\n",
+			fault_stats.faults, fault_stats.around);
+	printf ("Advice: %lld pages read ahead, %lld dropped\n",
+			fault_stats.willneed, fault_stats.dontneed);
+	printf ("Writeback: %lld mapped pages in %lld writes, "
+			"%lld flush daemon passes\n",
+			wb_stats.pages, wb_stats.writes, wb_stats.passes);
+	printf ("COW: %lld pages shared, %lld copied, %lld reused\n",
+			frame_stats.cow_shared, frame_stats.cow_copied,
+			frame_stats.cow_reused);
+	printf ("Text: %zu frames shared by program, %lld hits\n",
+			hash_size (&text_frames), frame_stats.text_hits);
+	printf ("Zero: %zu pages on the zero page, %lld mapped, "
+			"%lld written\n", zero_frame->refcnt, frame_stats.zero_mapped,
+			frame_stats.zero_written);
+	hash_first (&i, &merged_frames);
+	while (hash_next (&i))
+		merged_pages += hash_entry (hash_cur (&i), struct frame,
+				merge_elem)->refcnt;
+	printf ("KSM: %zu merged frames mapped by %zu pages, %lld scanned, "
+			"%lld merged (%lld into the zero page)\n",
+			hash_size (&merged_frames), merged_pages,
+			frame_stats.merge_scanned, frame_stats.merged,
+			frame_stats.merged_zero);
+	zswap_print_stats ();
+	swap_print_stats ();
+}
+
+/* Growing the stack down to the page containing ADDR. */
+static void
+vm_stack_growth (void *addr) {
+	struct thread *curr = thread_current ();
+	struct vma *stack = spt_find_vma (&curr->spt, (uint8_t *) USER_STACK - 1);
+	void *bottom = pg_round_down (addr);
+	struct avl_elem *prev;
+
+	if (stack == NULL || !(stack->flags & VMA_STACK) || bottom >= stack->start)
+		return;
+	prev = avl_prev (&stack->elem);
+	if (prev != NULL && avl_entry (prev, struct vma, elem)->end > bottom)
+		return;
+
+	/* The tree order is unchanged: nothing lies between BOTTOM and
+	 * the old start. */
+	stack->start = bottom;
+	curr->stack_bottom = bottom;
+}
+
+/* Handle the fault on write_protected page.
+ *
+ * A writable page is mapped read-only while fork has it sharing a
+ * frame, or while it is on the zero page.  The first write gives the
+ * writer a copy of its own, or, if every other sharer is gone, hands
+ * it the frame as it is.  The zero page is always copied. */
+static bool
+vm_handle_wp (struct page *page) {
+	struct frame *shared, *frame;
+
+	if (!page->writable)
+		return false;
+
+	lock_acquire (&frame_lock);
+	vm_wait_io (page);
+	shared = page->frame;
+	if (shared == NULL) {
+		/* Evicted since the fault; it comes back writable. */
+		lock_release (&frame_lock);
+		return vm_do_claim_page (page);
+	}
+	if (shared->refcnt == 1 && shared != zero_frame) {
+		merge_remove (shared);
+		pml4_set_writable (page->owner->pml4, page->va, true);
+		frame_stats.cow_reused++;
+	} else {
+		/* Finding a frame for the copy may drop the lock to evict a
+		 * page, and the other sharers may go meanwhile.  Pin SHARED so
+		 * that it stays put. */
+		bool was_pinned = shared->pinned;
+
+		shared->pinned = true;
+		frame = vm_get_frame (true);
+		shared->pinned = was_pinned;
+		if (shared == zero_frame) {
+			memset (frame->kva, 0, PGSIZE);
+			memstat_charge (page->owner, MEMSTAT_RESIDENT, 1);
+			frame_stats.zero_written++;
+		} else {
+			memcpy (frame->kva, shared->kva, PGSIZE);
+			frame_stats.cow_copied++;
+		}
+		frame_unlink (page);
+		frame_link (frame, page);
+		pml4_set_page (page->owner->pml4, page->va, frame->kva, true);
+		frame->pinned = false;
+		if (shared != zero_frame && shared->refcnt == 0)
+			frame_release (shared);
+	}
+	lock_release (&frame_lock);
+	return true;
+}
+
+/* Returns true if a fault at ADDR with stack pointer RSP looks like a
+ * push or a stack access just below the current stack. */
+static bool
+is_stack_access (void *addr, void *rsp) {
+	return (uint8_t *) addr >= STACK_LIMIT
+		&& (uint8_t *) addr < (uint8_t *) USER_STACK
+		&& (uint8_t *) addr >= (uint8_t *) rsp - 8;
+}
+
+/* Maps the file-backed pages of VMA around the faulting page VA that
+ * are not resident, so a sequential scan takes one fault per
+ * fault_around_pages pages instead of one per page.  The window is
+ * the aligned block of fault_around_pages pages that holds VA, or,
+ * in an area advised sequential, the twice as many pages from VA on.
+ * An area advised random gets none.  Pages go only into free frames:
+ * fault-around must not push out pages that are in use for ones that
+ * may never be touched. */
+static void
+vm_fault_around (struct supplemental_page_table *spt, struct vma *vma,
+		void *va) {
+	size_t window = fault_around_pages * PGSIZE;
+	uint8_t *start, *end, *p;
+
+	if (fault_around_pages <= 1 || (vma->flags & VMA_RANDOM)
+			|| !vma_page_in_file (vma, va))
+		return;
+	if (vma->flags & VMA_SEQUENTIAL) {
+		start = va;
+		end = start + 2 * window;
+	} else {
+		start = (uint8_t *) ROUND_DOWN ((uintptr_t) va, window);
+		end = start + window;
+	}
+	if (start < (uint8_t *) vma->start)
+		start = vma->start;
+	if (end > (uint8_t *) vma->end)
+		end = vma->end;
+
+	for (p = start; p < end; p += PGSIZE) {
+		struct page *page;
+
+		if (p == va || !vma_page_in_file (vma, p))
+			continue;
+		page = spt_find_page (spt, p);
+		if (page == NULL) {
+			page = page_new (spt, vma, p, vma_load_page, NULL);
+			if (page == NULL)
+				break;
+			if (!claim_page (page, false)) {
+				spt_remove_page (spt, page);
+				break;
+			}
+		} else if (page->frame != NULL || page_get_type (page) != VM_FILE)
+			continue;   /* Resident, or its data is in swap. */
+		else if (!claim_page (page, false))
+			break;
+		fault_stats.around++;
+	}
+}
+
+/* Reads in the pages of VMA in [START, END) that have data in its
+ * file or in swap, into free frames only. */
+static void
+vma_willneed (struct supplemental_page_table *spt, struct vma *vma,
+		uint8_t *start, uint8_t *end) {
+	uint8_t *p;
+
+	for (p = start; p < end; p += PGSIZE) {
+		struct page *page = spt_find_page (spt, p);
+
+		if (page == NULL) {
+			if (!vma_page_in_file (vma, p))
+				continue;
+			page = page_new (spt, vma, p, vma_load_page, NULL);
+			if (page == NULL)
+				return;
+			if (!claim_page (page, false)) {
+				spt_remove_page (spt, page);
+				return;
+			}
+		} else if (page->frame != NULL
+				|| VM_TYPE (page->operations->type) == VM_UNINIT)
+			continue;
+		else if (!claim_page (page, false))
+			return;
+		fault_stats.willneed++;
+	}
+}
+
+/* Removes the pages of VMA in [START, END) from SPT, discarding their
+ * contents, and returns how many there were. */
+static size_t
+vma_drop (struct supplemental_page_table *spt, struct vma *vma,
+		uint8_t *start, uint8_t *end) {
+	struct list_elem *e = list_begin (&vma->pages);
+	size_t cnt = 0;
+
+	while (e != list_end (&vma->pages)) {
+		struct page *page = list_entry (e, struct page, vma_elem);
+
+		e = list_next (e);
+		if ((uint8_t *) page->va >= start && (uint8_t *) page->va < end) {
+			spt_remove_page (spt, page);
+			cnt++;
+		}
+	}
+	return cnt;
+}
+
+/* Drops the pages of VMA in [START, END).  Anonymous contents are
+ * discarded rather than swapped, so the pages read back as they were
+ * first loaded; file-backed ones are written back if dirty. */
+static void
+vma_dontneed (struct supplemental_page_table *spt, struct vma *vma,
+		uint8_t *start, uint8_t *end) {
+	vma_writeback (vma, start, end);
+	fault_stats.dontneed += vma_drop (spt, vma, start, end);
+}
+
+/* Applies ADVICE, one of the MADV_* values, to the LENGTH bytes at
+ * page-aligned ADDR in the current process.  Read-ahead advice is
+ * kept per area, so it covers every area the range touches in full.
+ * Fails if part of the range is not mapped or ADVICE is unknown. */
+bool
+vm_madvise (void *addr, size_t length, int advice) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	uint8_t *start = addr;
+	uint8_t *end = start + ROUND_UP (length, PGSIZE);
+	uint8_t *p;
+	struct vma *vma;
+
+	if (pg_ofs (addr) != 0 || end < start || advice < MADV_NORMAL
+			|| advice > MADV_DONTNEED)
+		return false;
+	for (p = start; p < end; p = vma->end)
+		if ((vma = spt_find_vma (spt, p)) == NULL)
+			return false;
+
+	for (p = start; p < end; p = vma->end) {
+		uint8_t *lim;
+
+		vma = spt_find_vma (spt, p);
+		lim = end < (uint8_t *) vma->end ? end : vma->end;
+		switch (advice) {
+			case MADV_NORMAL:
+				vma->flags &= ~(VMA_RANDOM | VMA_SEQUENTIAL);
+				break;
+			case MADV_RANDOM:
+				vma->flags = (vma->flags & ~VMA_SEQUENTIAL) | VMA_RANDOM;
+				break;
+			case MADV_SEQUENTIAL:
+				vma->flags = (vma->flags & ~VMA_RANDOM) | VMA_SEQUENTIAL;
+				break;
+			case MADV_WILLNEED:
+				vma_willneed (spt, vma, p, lim);
+				break;
+			case MADV_DONTNEED:
+				vma_dontneed (spt, vma, p, lim);
+				break;
+		}
+	}
+	return true;
+}
+
+/* Starts the current process's heap just past its highest area, which
+ * is expected to be the end of the loaded program. */
+void
+vm_heap_init (void) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct avl_elem *e = avl_last (&spt->vmas);
+
+	spt->heap_start = spt->brk =
+		e != NULL ? avl_entry (e, struct vma, elem)->end : NULL;
+}
+
+/* Moves the current process's program break by INCREMENT bytes and
+ * returns the old break, or NULL on failure.  The heap is a single
+ * area from heap_start to the break rounded up to a page, grown and
+ * shrunk in place; it exists only while the break is past its start.
+ * Pages given back by shrinking are dropped, and read as zeros if
+ * the heap grows over them again. */
+void *
+vm_sbrk (intptr_t increment) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	uint8_t *start = spt->heap_start;
+	uint8_t *old_brk = spt->brk;
+	uint8_t *new_brk = old_brk + increment;
+	uint8_t *old_end = (uint8_t *) ROUND_UP ((uintptr_t) old_brk, PGSIZE);
+	uint8_t *new_end = (uint8_t *) ROUND_UP ((uintptr_t) new_brk, PGSIZE);
+	struct vma *heap;
+
+	if (start == NULL || new_brk < start
+			|| (increment > 0 ? new_brk < old_brk : new_brk > old_brk)
+			|| !is_user_vaddr (new_end - 1))
+		return NULL;
+
+	heap = old_end > start ? spt_find_vma (spt, start) : NULL;
+	if (new_end > old_end) {
+		if (heap == NULL) {
+			if (!vm_map (start, new_end - start, VM_ANON, true, VMA_HEAP,
+						NULL, 0, 0))
+				return NULL;
+		} else if (spt_overlaps (spt, old_end, new_end))
+			return NULL;
+		else
+			heap->end = new_end;
+	} else if (new_end < old_end) {
+		if (new_end == start)
+			vm_unmap (spt, heap);
+		else {
+			vma_drop (spt, heap, new_end, old_end);
+			heap->end = new_end;
+		}
+	}
+	spt->brk = new_brk;
+	return old_brk;
+}
+
+/* Finds LENGTH bytes of unmapped, page-aligned address space in the
+ * current process for an mmap() that leaves the address to the
+ * kernel.  The search runs downward from the lowest point the stack
+ * may reach, leaving the space above the break for the heap.
+ * Returns NULL if there is no such gap. */
+void *
+vm_find_gap (size_t length) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	uint8_t *floor = (uint8_t *) ROUND_UP ((uintptr_t) spt->brk, PGSIZE);
+	uint8_t *hi = STACK_LIMIT;
+	struct vma key;
+	struct avl_elem *e;
+
+	length = ROUND_UP (length, PGSIZE);
+	if (floor < (uint8_t *) PGSIZE)
+		floor = (uint8_t *) PGSIZE;
+
+	key.start = hi - 1;
+	for (e = avl_floor (&spt->vmas, &key.elem); ; e = avl_prev (e)) {
+		struct vma *vma = e != NULL ? avl_entry (e, struct vma, elem) : NULL;
+		uint8_t *lo = vma != NULL ? (uint8_t *) vma->end : floor;
+
+		if (lo < floor)
+			lo = floor;
+		if (lo <= hi && (size_t) (hi - lo) >= length)
+			return hi - length;
+		if (vma == NULL || (uint8_t *) vma->start <= floor)
+			return NULL;
+		if ((uint8_t *) vma->start < hi)
+			hi = vma->start;
+	}
+}
+
+/* Returns true if PAGE is a resident page of a file mapping that was
+ * written since it was last written back.  Pages of shared or pinned
+ * frames are left to their destructors and to eviction. */
+static bool
+page_needs_writeback (struct page *page) {
+	return page->frame != NULL && !page->frame->pinned
+		&& page->frame->refcnt == 1 && page_is_mmap (page)
+		&& page->file.read_bytes > 0 && page->owner->pml4 != NULL
+		&& pml4_is_dirty (page->owner->pml4, page->va);
+}
+
+/* Orders pages by backing inode, then by file offset. */
+static int
+wb_compare (const void *a_, const void *b_) {
+	const struct page *a = *(struct page *const *) a_;
+	const struct page *b = *(struct page *const *) b_;
+	struct inode *ia = file_get_inode (a->file.file);
+	struct inode *ib = file_get_inode (b->file.file);
+
+	if (ia != ib)
+		return ia < ib ? -1 : 1;
+	return a->file.offset < b->file.offset ? -1
+		: a->file.offset > b->file.offset;
+}
+
+/* Returns true if NEXT continues PREV in their file, so both can go
+ * out with one write. */
+static bool
+wb_adjacent (const struct page *prev, const struct page *next) {
+	return file_get_inode (prev->file.file) == file_get_inode (next->file.file)
+		&& prev->file.read_bytes == PGSIZE
+		&& next->file.offset == prev->file.offset + PGSIZE;
+}
+
+/* Writes the CNT consecutive pages at PAGES to their file with one
+ * write, and releases their frames.  The frames were pinned and marked
+ * writing when the batch was collected, so the frame table lock is
+ * dropped for the write.
+ *
+ * A page's dirty bit is cleared only if the write stored all of it,
+ * and then only if the page still matches what was written.  The bit
+ * is cleared before the comparison, so a store racing with it either
+ * shows up in the comparison or sets the bit again. */
+static void
+wb_write_run (struct page **pages, size_t cnt) {
+	size_t bytes = 0;
+	off_t written;
+	size_t i;
+
+	for (i = 0; i < cnt; i++) {
+		memcpy (wb_buf + bytes, pages[i]->frame->kva,
+				pages[i]->file.read_bytes);
+		bytes += pages[i]->file.read_bytes;
+	}
+	lock_release (&frame_lock);
+	written = file_write_at (pages[0]->file.file, wb_buf, bytes,
+			pages[0]->file.offset);
+	lock_acquire (&frame_lock);
+
+	bytes = 0;
+	for (i = 0; i < cnt; i++) {
+		struct page *page = pages[i];
+		size_t size = page->file.read_bytes;
+
+		if ((off_t) (bytes + size) <= written) {
+			pml4_set_dirty (page->owner->pml4, page->va, false);
+			if (memcmp (wb_buf + bytes, page->frame->kva, size))
+				pml4_set_dirty (page->owner->pml4, page->va, true);
+		}
+		bytes += size;
+		page->frame->pinned = false;
+		page->frame->writing = false;
+	}
+	cond_broadcast (&io_done, &frame_lock);
+	wb_stats.pages += cnt;
+	wb_stats.writes++;
+}
+
+/* Writes back the pages of BATCH, run by run, and empties it.  The
+ * frame table lock is dropped during each write. */
+static void
+wb_flush (struct wb_batch *batch) {
+	size_t i, j;
+
+	ASSERT (lock_held_by_current_thread (&wb_lock));
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	qsort (batch->pages, batch->cnt, sizeof *batch->pages, wb_compare);
+	for (i = 0; i < batch->cnt; i = j) {
+		for (j = i + 1; j < batch->cnt
+				&& wb_adjacent (batch->pages[j - 1], batch->pages[j]); j++)
+			continue;
+		wb_write_run (batch->pages + i, j - i);
+	}
+	batch->cnt = 0;
+}
+
+/* Adds PAGE to BATCH if it needs writing back, pinning its frame and
+ * marking it writing until wb_write_run() is done with it, so that it
+ * stays put once the frame table lock is dropped.  Returns true if that
+ * filled the batch, which the caller must then flush. */
+static bool
+wb_add (struct wb_batch *batch, struct page *page) {
+	if (page_needs_writeback (page)) {
+		page->frame->pinned = true;
+		page->frame->writing = true;
+		batch->pages[batch->cnt++] = page;
+	}
+	return batch->cnt == WB_BATCH;
+}
+
+/* Writes back the dirty pages of VMA in [START, END), if it maps a
+ * file. */
+static void
+vma_writeback (struct vma *vma, uint8_t *start, uint8_t *end) {
+	struct wb_batch batch;
+	struct list_elem *e;
+
+	if (VM_TYPE (vma->type) != VM_FILE || (vma->flags & VMA_TEXT))
+		return;
+
+	batch.cnt = 0;
+	lock_acquire (&wb_lock);
+	lock_acquire (&frame_lock);
+	for (e = list_begin (&vma->pages); e != list_end (&vma->pages);
+			e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, vma_elem);
+
+		if ((uint8_t *) page->va >= start && (uint8_t *) page->va < end
+				&& wb_add (&batch, page))
+			wb_flush (&batch);
+	}
+	wb_flush (&batch);
+	lock_release (&frame_lock);
+	lock_release (&wb_lock);
+}
+
+/* Writes the modified pages of file mappings in the LENGTH bytes at
+ * page-aligned ADDR in the current process back to their files.
+ * Other areas in the range are left alone.  Fails if part of the
+ * range is not mapped. */
+bool
+vm_msync (void *addr, size_t length) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	uint8_t *start = addr;
+	uint8_t *end = start + ROUND_UP (length, PGSIZE);
+	uint8_t *p;
+	struct vma *vma;
+
+	if (pg_ofs (addr) != 0 || end < start)
+		return false;
+	for (p = start; p < end; p = vma->end)
+		if ((vma = spt_find_vma (spt, p)) == NULL)
+			return false;
+
+	for (p = start; p < end; p = vma->end) {
+		vma = spt_find_vma (spt, p);
+		vma_writeback (vma, p, end < (uint8_t *) vma->end ? end : vma->end);
+	}
+	return true;
+}
+
+/* Writes back dirty pages of file mappings all over the frame table,
+ * for the flush daemon.  The frame table lock is dropped for each
+ * write, so faults do not wait for the disk. */
+void
+vm_writeback (void) {
+	struct wb_batch batch;
+	size_t left;
+
+	batch.cnt = 0;
+	lock_acquire (&wb_lock);
+	lock_acquire (&frame_lock);
+	for (left = frame_cnt; left > 0 && frame_cnt > 0; left--) {
+		struct frame *frame;
+
+		if (wb_cursor == NULL || wb_cursor == list_end (&frame_list))
+			wb_cursor = list_begin (&frame_list);
+		frame = list_entry (wb_cursor, struct frame, elem);
+		wb_cursor = list_next (wb_cursor);
+		if (frame->refcnt != 1)
+			continue;
+		if (wb_add (&batch, list_entry (list_front (&frame->pages),
+						struct page, frame_elem)))
+			wb_flush (&batch);
+	}
+	wb_flush (&batch);
+	wb_stats.passes++;
+	lock_release (&frame_lock);
+	lock_release (&wb_lock);
 }
 
 /* Return true on success */
 bool
-vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
-		bool user UNUSED, bool write UNUSED, bool not_present UNUSED) {
-	struct supplemental_page_table *spt UNUSED = &thread_current ()->spt;
+vm_try_handle_fault (struct intr_frame *f, void *addr,
+		bool user, bool write, bool not_present) {
+	enum fault_class class;
+	return vm_handle_fault (f, addr, user, write, not_present, &class);
+}
+
+/* Returns the cause of a not-present fault on PAGE, which is not
+ * resident. */
+static enum fault_class
+fault_class_of (struct page *page) {
+	if (VM_TYPE (page->operations->type) == VM_ANON)
+		return FAULT_SWAP;
+	if (page_is_mmap (page))
+		return FAULT_FILE;
+	if (vma_page_in_file (page->vma, page->va))
+		return FAULT_ELF;
+	return FAULT_ZERO;
+}
+
+/* Like vm_try_handle_fault(), but on success also stores the cause of
+ * the fault in *CLASS. */
+bool
+vm_handle_fault (struct intr_frame *f, void *addr, bool user, bool write,
+		bool not_present, enum fault_class *class) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
 	struct page *page = NULL;
-	/* TODO: Validate the fault */
-	/* TODO: Your code goes here */
+	struct vma *vma;
+	bool grown = false;
+	bool success;
 
-	return vm_do_claim_page (page);
+	if (addr == NULL || !is_user_vaddr (addr))
+		return false;
+
+	page = spt_find_page (spt, addr);
+	if (!not_present) {
+		if (!write || page == NULL)
+			return false;
+		*class = page->frame == zero_frame ? FAULT_ZERO : FAULT_COW;
+		return vm_handle_wp (page);
+	}
+
+	if (page == NULL) {
+		vma = spt_find_vma (spt, addr);
+		if (vma == NULL) {
+			/* A kernel fault on a user address happens inside a system
+			 * call, whose entry saved the user stack pointer. */
+			void *rsp = user ? (void *) f->rsp
+				: thread_current ()->stack_pointer;
+			if (!is_stack_access (addr, rsp))
+				return false;
+			vm_stack_growth (addr);
+			vma = spt_find_vma (spt, addr);
+			if (vma == NULL)
+				return false;
+			grown = true;
+		}
+		if (write && !vma->writable)
+			return false;
+		page = page_new (spt, vma, pg_round_down (addr), vma_load_page, NULL);
+		if (page == NULL)
+			return false;
+	} else if (write && !page->writable)
+		return false;
+	*class = grown ? FAULT_STACK : fault_class_of (page);
+
+	/* Reading memory that was never written needs no frame. */
+	if (!write && page_is_zero (page))
+		success = zero_attach (page);
+	else
+		success = vm_do_claim_page (page);
+	if (!success)
+		return false;
+	fault_stats.faults++;
+	vm_fault_around (spt, page->vma, page->va);
+	return true;
 }
 
 /* Free the page.
@@ -148,11 +1536,22 @@ vm_dealloc_page (struct page *page) {
 	free (page);
 }
 
-/* Claim the page that allocate on VA. */
+/* Claim the page that allocate on VA.  Succeeds at once if the page
+ * is already resident. */
 bool
-vm_claim_page (void *va UNUSED) {
-	struct page *page = NULL;
-	/* TODO: Fill this function */
+vm_claim_page (void *va) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct page *page = spt_find_page (spt, va);
+
+	if (page == NULL) {
+		struct vma *vma = spt_find_vma (spt, va);
+		if (vma == NULL)
+			return false;
+		page = page_new (spt, vma, pg_round_down (va), vma_load_page, NULL);
+		if (page == NULL)
+			return false;
+	} else if (page->frame != NULL)
+		return true;
 
 	return vm_do_claim_page (page);
 }
@@ -160,31 +1559,258 @@ vm_claim_page (void *va UNUSED) {
 /* Claim the PAGE and set up the mmu. */
 static bool
 vm_do_claim_page (struct page *page) {
-	struct frame *frame = vm_get_frame ();
+	return claim_page (page, true);
+}
+
+/* Brings PAGE into a frame, evicting another page for it if that is
+ * the only way and MAY_EVICT is set.  The frame table lock is not
+ * held while the page is read in; the frame stays pinned instead. */
+static bool
+claim_page (struct page *page, bool may_evict) {
+	struct frame *frame;
+	bool success;
+
+	lock_acquire (&frame_lock);
+	vm_wait_io (page);
+	if (page->frame != NULL) {
+		/* Claimed by someone else while we waited for the lock. */
+		lock_release (&frame_lock);
+		return true;
+	}
+	if (page_is_text (page) && (frame = text_lookup (page)) != NULL) {
+		/* Another process running the same program has it. */
+		frame_link (frame, page);
+		memstat_charge (page->owner, MEMSTAT_RESIDENT, 1);
+		frame_stats.text_hits++;
+		lock_release (&frame_lock);
+		return page_attach (page);
+	}
+	frame = vm_get_frame (may_evict);
+	if (frame == NULL) {
+		lock_release (&frame_lock);
+		return false;
+	}
 
 	/* Set links */
-	frame->page = page;
-	page->frame = frame;
+	frame_link (frame, page);
+	memstat_charge (page->owner, MEMSTAT_RESIDENT, 1);
+	if (page_is_mmap (page))
+		memstat_charge (page->owner, MEMSTAT_MMAP, 1);
+	lock_release (&frame_lock);
 
-	/* TODO: Insert page table entry to map page's VA to frame's PA. */
+	/* Map the page before filling it, so a failure can be undone the
+	 * same way as any other resident page. */
+	success = pml4_set_page (page->owner->pml4, page->va, frame->kva,
+			page->writable)
+		&& swap_in (page, frame->kva);
 
-	return swap_in (page, frame->kva);
+	lock_acquire (&frame_lock);
+	if (success) {
+		frame->pinned = false;
+		if (page_is_text (page))
+			text_insert (frame, page);
+	} else
+		vm_free_frame (page);
+	lock_release (&frame_lock);
+	return success;
+}
+
+/* Maps PAGE, just linked to a frame that already holds its contents,
+ * read-only.  A page that was never faulted in gets its type-specific
+ * state from its initializer, but not its contents: the custom
+ * initializer, which would fill the frame, is dropped. */
+static bool
+page_attach (struct page *page) {
+	void *kva = page->frame->kva;
+	bool success = true;
+
+	if (VM_TYPE (page->operations->type) == VM_UNINIT) {
+		page->uninit.init = NULL;
+		success = swap_in (page, kva);
+	}
+	if (!success
+			|| !pml4_set_page (page->owner->pml4, page->va, kva, false)) {
+		lock_acquire (&frame_lock);
+		vm_free_frame (page);
+		lock_release (&frame_lock);
+		return false;
+	}
+	return true;
+}
+
+/* Maps PAGE, which must start out all zeros, to the zero page. */
+static bool
+zero_attach (struct page *page) {
+	lock_acquire (&frame_lock);
+	frame_link (zero_frame, page);
+	frame_stats.zero_mapped++;
+	lock_release (&frame_lock);
+	return page_attach (page);
+}
+
+/* Takes PAGE's frame off its owner's resident counters. */
+static void
+page_uncharge (struct page *page) {
+	memstat_charge (page->owner, MEMSTAT_RESIDENT, -1);
+	if (page_is_mmap (page))
+		memstat_charge (page->owner, MEMSTAT_MMAP, -1);
+}
+
+static uint64_t
+page_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct page *p = hash_entry (e, struct page, spt_elem);
+	return hash_bytes (&p->va, sizeof p->va);
+}
+
+static bool
+page_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct page, spt_elem)->va
+		< hash_entry (b, struct page, spt_elem)->va;
+}
+
+static bool
+vma_less (const struct avl_elem *a, const struct avl_elem *b,
+		void *aux UNUSED) {
+	return avl_entry (a, struct vma, elem)->start
+		< avl_entry (b, struct vma, elem)->start;
 }
 
 /* Initialize new supplemental page table */
 void
-supplemental_page_table_init (struct supplemental_page_table *spt UNUSED) {
+supplemental_page_table_init (struct supplemental_page_table *spt) {
+	avl_init (&spt->vmas, vma_less, NULL);
+	if (!hash_init (&spt->pages, page_hash, page_less, NULL))
+		PANIC ("supplemental_page_table_init: out of memory");
+	spt->hint = NULL;
+	spt->heap_start = spt->brk = NULL;
+}
+
+/* Fills a child's page from the parent's frame at AUX. */
+static bool
+copy_page_init (struct page *page, void *aux) {
+	memcpy (page->frame->kva, aux, PGSIZE);
+	return true;
+}
+
+/* Maps the frame of resident SRC_PAGE at the same address in area
+ * VMA of DST, read-only on both sides until one of them writes. */
+static bool
+share_page (struct supplemental_page_table *dst, struct vma *vma,
+		struct page *src_page) {
+	struct frame *frame = src_page->frame;
+	struct page *page = page_new (dst, vma, src_page->va, NULL, NULL);
+
+	if (page == NULL)
+		return false;
+
+	lock_acquire (&frame_lock);
+	frame_link (frame, page);
+	memstat_charge (page->owner, MEMSTAT_RESIDENT, 1);
+	lock_release (&frame_lock);
+
+	if (!page_attach (page))
+		return false;
+	pml4_set_writable (src_page->owner->pml4, src_page->va, false);
+	frame_stats.cow_shared++;
+	return true;
+}
+
+/* Duplicates SRC's page SRC_PAGE into area VMA of DST.  Anonymous
+ * pages are shared copy-on-write, and shared text simply shared;
+ * mmapped ones, which are written back from their own frame, are
+ * copied. */
+static bool
+copy_page (struct supplemental_page_table *dst, struct vma *vma,
+		struct page *src_page) {
+	struct page *page;
+	bool success;
+
+	/* Pages that were never claimed stay lazy in the child too. */
+	if (VM_TYPE (src_page->operations->type) == VM_UNINIT)
+		return page_new (dst, vma, src_page->va, src_page->uninit.init,
+				src_page->uninit.aux) != NULL;
+
+	/* Still zero in the parent, so zero in the child too. */
+	if (src_page->frame == zero_frame) {
+		page = page_new (dst, vma, src_page->va, NULL, NULL);
+		return page != NULL && zero_attach (page);
+	}
+
+	/* The parent's page may be swapped out, and must not be evicted
+	 * while it is shared or copied. */
+	if (!page_pin (src_page))
+		return false;
+	if (VM_TYPE (src_page->operations->type) == VM_ANON
+			|| page_is_text (src_page))
+		success = share_page (dst, vma, src_page);
+	else {
+		page = page_new (dst, vma, src_page->va, copy_page_init,
+				src_page->frame->kva);
+		success = page != NULL && vm_do_claim_page (page);
+	}
+	page_unpin (src_page);
+	return success;
 }
 
-/* Copy supplemental page table from src to dst */
+/* Copy supplemental page table from src to dst.  Areas are copied as
+ * ranges, and the parent's anonymous pages are shared rather than
+ * copied, so the cost grows with the number of pages mapped, not with
+ * the bytes in them. */
 bool
-supplemental_page_table_copy (struct supplemental_page_table *dst UNUSED,
-		struct supplemental_page_table *src UNUSED) {
+supplemental_page_table_copy (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src) {
+	struct avl_elem *e;
+
+	for (e = avl_first (&src->vmas); e != NULL; e = avl_next (e)) {
+		struct vma *src_vma = avl_entry (e, struct vma, elem);
+		struct vma *vma;
+		struct list_elem *p;
+
+		if (!vm_map (src_vma->start,
+					(uint8_t *) src_vma->end - (uint8_t *) src_vma->start,
+					src_vma->type, src_vma->writable, src_vma->flags,
+					src_vma->file, src_vma->offset, src_vma->read_bytes))
+			return false;
+		vma = spt_find_vma (dst, src_vma->start);
+
+		for (p = list_begin (&src_vma->pages); p != list_end (&src_vma->pages);
+				p = list_next (p))
+			if (!copy_page (dst, vma, list_entry (p, struct page, vma_elem)))
+				return false;
+	}
+	dst->heap_start = src->heap_start;
+	dst->brk = src->brk;
+	return true;
+}
+
+static void
+vma_destroy (struct avl_elem *e, void *spt) {
+	struct vma *vma = avl_entry (e, struct vma, elem);
+
+	vma_writeback (vma, vma->start, vma->end);
+	while (!list_empty (&vma->pages)) {
+		struct page *page = list_entry (list_pop_front (&vma->pages),
+				struct page, vma_elem);
+		hash_delete (&((struct supplemental_page_table *) spt)->pages,
+				&page->spt_elem);
+		memstat_charge (page->owner, MEMSTAT_KERNEL, -(long) sizeof *page);
+		lock_acquire (&frame_lock);
+		vm_dealloc_page (page);
+		lock_release (&frame_lock);
+	}
+	file_close (vma->file);
+	memstat_charge (thread_current (), MEMSTAT_KERNEL, -(long) sizeof *vma);
+	free (vma);
 }
 
-/* Free the resource hold by the supplemental page table */
+/* Free the resource hold by the supplemental page table.  Dirty
+ * file-backed pages are written back by their destructors.  The table
+ * must be initialized again before it is reused. */
 void
-supplemental_page_table_kill (struct supplemental_page_table *spt UNUSED) {
-	/* TODO: Destroy all the supplemental_page_table hold by thread and
-	 * TODO: writeback all the modified contents to the storage. */
+supplemental_page_table_kill (struct supplemental_page_table *spt) {
+	spt->vmas.aux = spt;
+	avl_clear (&spt->vmas, vma_destroy);
+	hash_destroy (&spt->pages, NULL);
+	spt->hint = NULL;
 }
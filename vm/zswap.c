@@ -0,0 +1,229 @@
+/* zswap.c: Compressed cache in front of the swap disk.
+ *
+ * An evicted anonymous page is first compressed into a pool of kernel
+ * memory, which is far cheaper to fault back in than a disk read.  The
+ * pool is carved into 64-byte chunks; a compressed page takes a run of
+ * adjacent chunks found by first fit.  Pages that do not shrink to
+ * three quarters of their size are not worth keeping and go straight
+ * to disk.
+ *
+ * When the pool is full, the entries that were stored longest ago are
+ * written back to the swap disk to make room, so the pool holds the
+ * most recently evicted pages, which are the likeliest to be faulted
+ * back in. */
+
+#include "vm/zswap.h"
+#include <bitmap.h>
+#include <list.h>
+#include <lz.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "vm/vm.h"
+#include "vm/swap.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "userprog/memstat.h"
+
+/* Allocation unit of the pool. */
+#define CHUNK_SIZE 64
+
+/* Largest compressed size worth storing. */
+#define MAX_STORED (PGSIZE / 4 * 3)
+
+/* A compressed page in the pool. */
+struct zswap_entry {
+	size_t chunk;               /* First chunk. */
+	size_t len;                 /* Compressed length in bytes. */
+	struct page *page;          /* Page whose contents these are. */
+	struct list_elem lru;       /* Element in lru_list. */
+};
+
+size_t zswap_pool_pages = 64;
+
+static uint8_t *pool;
+static struct bitmap *used_chunks;      /* Set bit: chunk is in use. */
+static struct list lru_list;            /* Entries, oldest first. */
+static struct lock zswap_lock;
+
+/* Scratch space for the codec, used under zswap_lock. */
+static uint8_t *scratch;
+static uint16_t lz_table[LZ_TABLE_SIZE];
+
+/* Compression statistics. */
+static struct {
+	long long stored;           /* Pages stored. */
+	long long hits;             /* Faults served from the pool. */
+	long long incompressible;   /* Pages rejected as incompressible. */
+	long long written_back;     /* Entries moved to the swap disk. */
+	long long orig_bytes;       /* Size of the pages stored. */
+	long long comp_bytes;       /* Their size once compressed. */
+} zswap_stats;
+
+/* Sets up the pool.  On failure the cache is simply disabled. */
+void
+zswap_init (void) {
+	lock_init (&zswap_lock);
+	list_init (&lru_list);
+	if (zswap_pool_pages == 0)
+		return;
+
+	pool = palloc_get_multiple (0, zswap_pool_pages);
+	scratch = palloc_get_page (0);
+	used_chunks = bitmap_create (zswap_pool_pages * PGSIZE / CHUNK_SIZE);
+	if (pool == NULL || scratch == NULL || used_chunks == NULL) {
+		printf ("zswap: cannot allocate %zu page pool, disabled\n",
+				zswap_pool_pages);
+		if (pool != NULL)
+			palloc_free_multiple (pool, zswap_pool_pages);
+		if (scratch != NULL)
+			palloc_free_page (scratch);
+		if (used_chunks != NULL)
+			bitmap_destroy (used_chunks);
+		pool = NULL;
+		zswap_pool_pages = 0;
+	}
+}
+
+static size_t
+chunk_cnt (size_t len) {
+	return DIV_ROUND_UP (len, CHUNK_SIZE);
+}
+
+/* Kernel memory charged to the owner of entry E: the entry itself
+ * and its chunks of the pool. */
+static long
+entry_cost (const struct zswap_entry *e) {
+	return sizeof *e + chunk_cnt (e->len) * CHUNK_SIZE;
+}
+
+/* Removes entry E from the pool and frees it. */
+static void
+entry_free (struct zswap_entry *e) {
+	memstat_charge (e->page->owner, MEMSTAT_KERNEL, -entry_cost (e));
+	bitmap_set_multiple (used_chunks, e->chunk, chunk_cnt (e->len), false);
+	list_remove (&e->lru);
+	e->page->anon.zentry = NULL;
+	free (e);
+}
+
+/* Moves the oldest entry to the swap disk.  Returns false if there
+ * is no entry or no swap space left. */
+static bool
+writeback_oldest (void) {
+	struct zswap_entry *e;
+	size_t slot;
+
+	ASSERT (lock_held_by_current_thread (&zswap_lock));
+
+	if (list_empty (&lru_list))
+		return false;
+	e = list_entry (list_front (&lru_list), struct zswap_entry, lru);
+	if (lz_decompress (pool + e->chunk * CHUNK_SIZE, e->len, scratch, PGSIZE)
+			!= PGSIZE)
+		PANIC ("zswap: corrupt entry for page %p", e->page->va);
+	slot = swap_write (scratch);
+	if (slot == SWAP_ERROR)
+		return false;
+
+	/* The slot must be visible before the entry goes away, as
+	 * zswap_load() tells the owner where to look under zswap_lock. */
+	e->page->anon.slot = slot;
+	entry_free (e);
+	zswap_stats.written_back++;
+	return true;
+}
+
+/* Compresses the contents of resident PAGE into the pool.  Returns
+ * false if the page should go to the swap disk instead. */
+bool
+zswap_store (struct page *page) {
+	size_t len, cnt, chunk;
+	struct zswap_entry *e;
+
+	ASSERT (page->frame != NULL);
+	ASSERT (page->anon.zentry == NULL);
+
+	if (pool == NULL)
+		return false;
+	e = malloc (sizeof *e);
+	if (e == NULL)
+		return false;
+
+	lock_acquire (&zswap_lock);
+	len = lz_compress (page->frame->kva, PGSIZE, scratch, MAX_STORED, lz_table);
+	if (len == 0) {
+		zswap_stats.incompressible++;
+		goto fail;
+	}
+
+	cnt = chunk_cnt (len);
+	while ((chunk = bitmap_scan_and_flip (used_chunks, 0, cnt, false))
+			== BITMAP_ERROR)
+		if (!writeback_oldest ())
+			goto fail;
+	memcpy (pool + chunk * CHUNK_SIZE, scratch, len);
+
+	e->chunk = chunk;
+	e->len = len;
+	e->page = page;
+	list_push_back (&lru_list, &e->lru);
+	page->anon.zentry = e;
+	memstat_charge (page->owner, MEMSTAT_KERNEL, entry_cost (e));
+
+	zswap_stats.stored++;
+	zswap_stats.orig_bytes += PGSIZE;
+	zswap_stats.comp_bytes += len;
+	lock_release (&zswap_lock);
+	return true;
+
+fail:
+	lock_release (&zswap_lock);
+	free (e);
+	return false;
+}
+
+/* Decompresses PAGE into KVA and drops it from the pool.  Returns
+ * false if PAGE is not in the pool, in which case its swap slot, if
+ * any, is settled and may be read by the caller. */
+bool
+zswap_load (struct page *page, void *kva) {
+	struct zswap_entry *e;
+
+	lock_acquire (&zswap_lock);
+	e = page->anon.zentry;
+	if (e == NULL) {
+		lock_release (&zswap_lock);
+		return false;
+	}
+	if (lz_decompress (pool + e->chunk * CHUNK_SIZE, e->len, kva, PGSIZE)
+			!= PGSIZE)
+		PANIC ("zswap: corrupt entry for page %p", page->va);
+	entry_free (e);
+	zswap_stats.hits++;
+	lock_release (&zswap_lock);
+	return true;
+}
+
+/* Drops PAGE from the pool, if it is there. */
+void
+zswap_invalidate (struct page *page) {
+	lock_acquire (&zswap_lock);
+	if (page->anon.zentry != NULL)
+		entry_free (page->anon.zentry);
+	lock_release (&zswap_lock);
+}
+
+/* Prints compression statistics. */
+void
+zswap_print_stats (void) {
+	printf ("Zswap: %zu pages in pool, %lld stored, %lld hits, "
+			"%lld incompressible, %lld written back, %lld%% ratio\n",
+			list_size (&lru_list), zswap_stats.stored, zswap_stats.hits,
+			zswap_stats.incompressible, zswap_stats.written_back,
+			zswap_stats.orig_bytes != 0
+			? zswap_stats.comp_bytes * 100 / zswap_stats.orig_bytes : 0);
+}